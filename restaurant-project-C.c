@@ -1,15 +1,38 @@
+#ifdef _WIN32
+#define _CRT_RAND_S // rand_s, for password salts
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <time.h>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define COLUMN_KERNELS_X86
+#include <immintrin.h>
+#endif
 #ifdef _WIN32
 #include <conio.h>
 #include <windows.h>
+#include <io.h>
+#define strcasecmp _stricmp
+#define strtok_r strtok_s
 #else
 #include <termios.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <strings.h>
 #endif
 
 // ANSI color codes
@@ -27,33 +50,233 @@
 #define COLOR_YELLOW  "\033[1;33m"
 #define COLOR_RED     "\033[1;31m"
 #define COLOR_BLUE    "\033[1;34m"
+#define ESCAPE_CHAR   '\033'
 
-#define MAX_USERS 100
-#define MAX_MENU_ITEMS 50
-#define MAX_ORDERS 50
-#define MAX_CATEGORIES 3
+#define MENU_SEARCH_LIMIT 20
 #define ITEMS_PER_CATEGORY 3
 
+// Table storage: records live in fixed-size chunks carved from an arena, so a
+// record never moves once appended and growth only touches the chunk directory.
+#define STORE_CHUNK_SHIFT 10
+#define STORE_CHUNK_RECORDS (1 << STORE_CHUNK_SHIFT)
+#define ARENA_BLOCK_SIZE (1 << 20)
+#define ARENA_ALIGNMENT 16
+
+// Open-addressing indexes over the unique user fields
+#define HASH_INDEX_MIN_CAPACITY 64
+#define HASH_INDEX_MAX_LOAD_PERCENT 70
+
+// Binary order log: orders.txt is the last compacted snapshot and orders.log
+// holds every order and status change appended since.
+#define ORDER_LOG_MAGIC 0x474F4C4F // "OLOG"
+#define ORDER_LOG_VERSION 1
+#define ORDER_LOG_COMPACT_MIN 1024
+#define ORDER_LOG_BUFFER (64 * 1024)
+
+// Persistence events wait in a bounded ring for the writer thread
+#define PERSIST_QUEUE_CAPACITY 1024
+
+// Binary menu file, rewritten whole on every edit
+#define MENU_FILE_MAGIC 0x554E454D // "MENU"
+#define MENU_FILE_VERSION 2
+
+// Menu slot map: an item id is its slot plus the slot's generation, so ids stay
+// put across edits and a reused slot never answers to an old id.
+#define MENU_SLOT_BITS 20
+#define MENU_SLOT_MASK ((1u << MENU_SLOT_BITS) - 1)
+#define MENU_GENERATION_MASK ((1u << (32 - MENU_SLOT_BITS)) - 1)
+#define MENU_NO_ITEM 0xFFFFFFFFu
+#define MENU_CHUNK_SHIFT 6
+#define MENU_CHUNK_SLOTS (1 << MENU_CHUNK_SHIFT)
+
+#define MAX_CART_LINES 20
+
+// Passwords are stored as pbkdf2$<iterations>$<salt hex>$<hash hex>
+#define PASSWORD_INPUT_LENGTH 50
+#define PASSWORD_HASH_LENGTH 128
+#define PASSWORD_SALT_BYTES 16
+#define KDF_DEFAULT_ITERATIONS 100000
+#define KDF_MIN_ITERATIONS 1000
+#define KDF_MAX_ITERATIONS 100000000
+#define KDF_DEFAULT_TARGET_MS 100
+#define CREDENTIAL_CACHE_SLOTS 64
+#define CREDENTIAL_CACHE_SECONDS 300
+#define USER_SAVE_DELAY_SECONDS 5     // batches users.txt rewrites for upgraded hashes
+
+// Per-thread cache of formatted local minutes for order timestamps
+#define CLOCK_CACHE_SLOTS 64
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Staff order screens show one page of a time range at a time
+#define ORDER_PAGE_SIZE 50
+#define RECENT_ORDER_MINUTES 30
+
+// Sales analytics: aggregates are updated as orders are created, so reports
+// never have to rescan the order table.
+#define SALES_TOP_N 5
+#define SALES_DAYS_SHOWN 7
+#define SALES_RECENT_MINUTES 60
+#define COLUMN_BENCH_ROUNDS 5
+
+// Replay driver
+#define REPLAY_LINE_LENGTH 512
+#define REPLAY_MAX_TOKENS (2 + 2 * MAX_CART_LINES)
+#define COMMAND_DETAIL_LENGTH 64
+
+// Payments: a pool of workers hands queued payments to the provider, so the
+// terminal never waits on the gateway. The mock provider's defaults can be
+// overridden with PAYMENT_LATENCY_MS, PAYMENT_JITTER_MS, PAYMENT_FAILURE_PERCENT
+// and PAYMENT_WORKERS.
+#define PAYMENT_QUEUE_CAPACITY 4096
+#define PAYMENT_NOTICE_SLOTS 16
+#define PAYMENT_DEFAULT_WORKERS 4
+#define PAYMENT_MAX_WORKERS 64
+#define PAYMENT_MOCK_LATENCY_MS 300
+#define PAYMENT_MOCK_JITTER_MS 100
+#define PAYMENT_MOCK_FAILURE_PERCENT 5
+
+// Metrics: set METRICS_FILE to time the main operations into log-linear
+// histograms and count file I/O. Buckets are exact below 2^METRIC_SUB_BITS ns
+// and within 1/2^METRIC_SUB_BITS of the value above that, up to 2^METRIC_MAX_BITS ns.
+#define METRIC_SUB_BITS 5
+#define METRIC_SUB_BUCKETS (1 << METRIC_SUB_BITS)
+#define METRIC_MAX_BITS 40
+#define METRIC_BUCKETS ((METRIC_MAX_BITS - METRIC_SUB_BITS + 1) * METRIC_SUB_BUCKETS)
+
+// Benchmark suite: synthetic tables are generated from a fixed seed, so every
+// run sees the same data and results can be compared between commits.
+#define BENCH_DEFAULT_USERS 20000
+#define BENCH_DEFAULT_ITEMS 200
+#define BENCH_DEFAULT_ORDERS 500000
+#define BENCH_SEED 0x5EED2024u
+#define BENCH_HISTORY_DAYS 30
+#define BENCH_PASSWORD "Bench#pass1"
+
+// Kitchen queues: bounded lock-free MPMC rings of order indexes
+#define KITCHEN_QUEUE_CAPACITY 65536
+#define CACHE_LINE_SIZE 64
+
+// Server mode: sessions share a fixed pool of worker threads, one command in
+// flight per session. Tables are guarded per table; the order log has its own
+// mutex because every order and status change appends to it.
+#define SERVER_MAX_SESSIONS 1024
+#define SERVER_DEFAULT_THREADS 4
+#define SERVER_DEFAULT_SOCKET "restaurant.sock"
+
+#ifdef _WIN32
+#define READ_LOCK(lock)
+#define WRITE_LOCK(lock)
+#define RW_UNLOCK(lock)
+#define MUTEX_LOCK(lock)
+#define MUTEX_UNLOCK(lock)
+#define COND_WAIT(cond, lock)
+#define COND_BROADCAST(cond)
+#else
+#define READ_LOCK(lock) pthread_rwlock_rdlock(&(lock))
+#define WRITE_LOCK(lock) pthread_rwlock_wrlock(&(lock))
+#define RW_UNLOCK(lock) pthread_rwlock_unlock(&(lock))
+#define MUTEX_LOCK(lock) pthread_mutex_lock(&(lock))
+#define MUTEX_UNLOCK(lock) pthread_mutex_unlock(&(lock))
+#define COND_WAIT(cond, lock) pthread_cond_wait(&(cond), &(lock))
+#define COND_BROADCAST(cond) pthread_cond_broadcast(&(cond))
+#endif
+
+// Roles are bit flags so permission checks can test several at once
+typedef enum {
+    ROLE_ADMIN = 1,
+    ROLE_CUSTOMER = 2,
+    ROLE_CHEF = 4
+} UserRole;
+
+#define ROLE_STAFF (ROLE_ADMIN | ROLE_CHEF)
+
+typedef enum {
+    STATUS_PROCESSING,
+    STATUS_READY,
+    STATUS_DELIVERED,
+    STATUS_COUNT
+} OrderStatus;
+
 typedef struct {
     char username[50];
     char email[100];
     char phone[15];
-    char password[50];
-    char role[20]; // Admin, Customer, Chef
+    char password[PASSWORD_HASH_LENGTH]; // PBKDF2 hash; plaintext until the first login after an upgrade
+    uint8_t role; // UserRole
+    int firstOrder;     // this customer's orders as a list through Order.nextByCustomer;
+    int lastOrder;      // both hold order index + 1, 0 when the customer has none
 } User;
 
+typedef uint32_t MenuItemId;
+
 typedef struct {
-    char name[50];
+    const char *name;   // interned
     char category[20];
     float price;
 } MenuItem;
 
+typedef struct {
+    MenuItem item;      // a tombstone keeps the deleted item's fields
+    uint32_t generation;
+    int nextFree;       // next tombstone on the free list, -1 at the end
+    bool live;
+} MenuSlot;
+
+// Live items of one category in slot order. The slot list is shared between
+// snapshots until an edit touches that category.
+typedef struct {
+    char name[20];
+    int count;
+    const int *slots;
+} MenuCategory;
+
+typedef struct TrieItem {
+    MenuItemId id;
+    struct TrieItem *next;
+} TrieItem;
+
+// Prefix trie over the words of item names, keyed by lowercased characters.
+// Nodes are only ever added, under menuWriteLock, and published with release
+// stores, so searches take no lock. Ids of deleted items stay behind and are
+// dropped by menuItemById.
+typedef struct TrieNode {
+    unsigned char key;
+    _Atomic(struct TrieNode *) child;     // first child; children are in key order
+    _Atomic(struct TrieNode *) sibling;
+    _Atomic(TrieItem *) items;            // names whose word ends here
+} TrieNode;
+
+// A published menu is never modified: an edit copies the chunk directory and the
+// one chunk it changes, then swaps the live pointer, so readers take no lock and
+// unchanged chunks are shared between snapshots. Replaced snapshots stay
+// allocated until exit because a reader may still hold one.
+typedef struct MenuSnapshot {
+    uint64_t version;
+    struct MenuSnapshot *retired;   // the snapshot this one replaced
+    MenuSlot **chunks;
+    int slotCount;      // live slots and tombstones
+    int liveCount;
+    int freeHead;       // first tombstone to reuse, -1 if none
+    MenuCategory *categories;   // sorted by name, ignoring case
+    int categoryCount;
+} MenuSnapshot;
+
 typedef struct {
     char customerName[50];
-    char itemName[50];
+    uint8_t status; // OrderStatus
+    uint8_t payment; // PaymentState
+    uint8_t queued; // QUEUED_BIT of each kitchen queue holding it, guarded by orderLogLock
     int quantity;
-    char status[20]; // Processing, Ready, Delivered
     float totalAmount;
+    int userId; // index into userStore, -1 when the customer is unknown
+    int nextByCustomer; // next order of the same customer, index + 1, 0 at the end
+    int sequence;       // stable number orders.log refers to it by; rises with the index
+    MenuItemId itemId;  // may name a deleted item, which menuItemById reports as NULL
+    const char *itemName; // interned, so it outlives the menu item
     time_t orderTime;
 } Order;
 
@@ -66,19 +289,511 @@ typedef enum {
     MASTERCARD
 } PaymentMethod;
 
-User users[MAX_USERS];
-MenuItem menu[MAX_MENU_ITEMS];
-Order orders[MAX_ORDERS];
-int userCount = 0, menuCount = 0, orderCount = 0;
+#define PAYMENT_METHOD_COUNT (MASTERCARD + 1)
+
+typedef enum {
+    PAYMENT_UNPAID,
+    PAYMENT_PENDING,    // with the provider; never saved
+    PAYMENT_PAID,
+    PAYMENT_DECLINED,
+    PAYMENT_STATE_COUNT
+} PaymentState;
+
+// A payment gateway. authorize may block for as long as the gateway takes; it
+// only runs on a payment worker, never on a terminal or server thread.
+typedef struct {
+    const char *name;
+    bool (*authorize)(PaymentMethod method, float amount);
+} PaymentProvider;
+
+typedef struct {
+    int latencyMs;
+    int jitterMs;           // latency varies by up to this much either way
+    int failurePercent;
+} MockGateway;
+
+// One payment covers a run of consecutive orders, normally a whole ticket
+typedef struct {
+    int firstOrder;
+    int orderCount;
+    uint8_t method;         // PaymentMethod
+    uint8_t state;          // PaymentState, once settled
+    float amount;
+    double submitted;       // monotonicSeconds
+} Payment;
+
+typedef enum {
+    OP_REGISTER,
+    OP_LOGIN,
+    OP_ORDER,
+    OP_STATUS,
+    OP_PAY,
+    OP_NEXT,
+    OP_DELIVER,
+    OP_SEARCH,
+    OP_METRICS,
+    OP_COUNT
+} ReplayOp;
+
+typedef struct {
+    double *samples;    // seconds per operation
+    int count;
+    int capacity;
+    int errors;
+} LatencySamples;
+
+typedef struct {
+    atomic_size_t sequence;
+    int orderIndex;
+} KitchenCell;
+
+// Vyukov's bounded MPMC queue: each cell's sequence number says whether it is
+// free for the producer at that position or filled for the consumer. Tickets
+// that find the ring full wait in a mutex-guarded spill list instead.
+typedef struct {
+    KitchenCell *cells;
+    size_t mask;
+    char padding0[CACHE_LINE_SIZE];
+    atomic_size_t enqueuePos;
+    char padding1[CACHE_LINE_SIZE];
+    atomic_size_t dequeuePos;
+    char padding2[CACHE_LINE_SIZE];
+    atomic_int spilled;     // spillCount, readable without the lock
+    int *spill;             // overflow in arrival order, oldest at spillHead
+    int spillHead;
+    int spillCount;
+    int spillCapacity;
+} KitchenQueue;
+
+#define QUEUED_BIT(status) (1 << (status))
+
+#ifndef _WIN32
+typedef struct {
+    int fd;
+    char input[REPLAY_LINE_LENGTH];    // bytes read but not yet dispatched
+    size_t length;
+    char command[REPLAY_LINE_LENGTH];  // line handed to a worker
+    atomic_bool busy;
+    bool hungUp;
+} Session;
+
+typedef struct {
+    Session *pending[SERVER_MAX_SESSIONS];
+    int head;
+    int count;
+    bool stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int wakeup[2];      // workers poke the poll loop when a session goes idle
+} WorkQueue;
+#endif
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    unsigned char *data;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+typedef struct {
+    Arena *arena;
+    size_t recordSize;
+    unsigned char **chunks;
+    int chunkCount;     // chunks carved from the arena so far
+    int chunkCapacity;  // slots in the chunk directory
+    int count;          // records in use
+} RecordStore;
+
+typedef struct {
+    unsigned int hash;
+    int record;         // user index + 1, 0 marks an empty slot
+} HashSlot;
+
+typedef struct {
+    size_t keyOffset;   // offset of the indexed string inside User
+    HashSlot *slots;
+    int capacity;       // always a power of two
+    int count;
+} HashIndex;
+
+// Interned item names: one copy per distinct name, never freed
+typedef struct {
+    unsigned int hash;
+    MenuItemId itemId;  // live menu item with this name, used to resolve loaded orders
+    int salesIndex;     // row in sales.items, -1 until the name is first sold
+    char text[];
+} NameEntry;
+
+typedef struct {
+    NameEntry **slots;
+    int capacity;       // always a power of two
+    int count;
+} NameTable;
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    bool mapped;        // false when data was read into a heap buffer
+} MappedFile;
+
+typedef struct {
+    const char *cursor; // next unread byte of the current line
+    const char *end;    // end of the current line, excluding "\r\n"
+} FieldReader;
+
+typedef struct {
+    MenuItemId item;
+    int quantity;
+} CartLine;
+
+typedef struct {
+    time_t minuteStart; // first second of the cached local minute
+    char prefix[6];     // "HH:MM"
+    bool valid;
+} ClockCacheEntry;
+
+typedef struct {
+    int *orders;        // order indexes sorted by orderTime, ties in index order
+    int count;
+    int capacity;
+} TimeIndex;
+
+typedef enum {
+    LOG_ORDER = 1,
+    LOG_STATUS = 2,
+    LOG_PAYMENT = 3
+} OrderLogType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+} OrderLogHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t formatVersion;
+    uint64_t menuVersion;
+    uint32_t itemCount;
+    uint32_t recordSize;
+} MenuFileHeader;
+
+typedef struct {
+    char name[50];
+    char category[20];
+    float price;
+    uint32_t generation;
+    uint32_t live;
+} MenuFileRecord;
+
+// Version 1 files had no tombstones: every record is a live item
+typedef struct {
+    char name[50];
+    char category[20];
+    float price;
+} MenuFileRecordV1;
+
+// Fixed-size on-disk record; LOG_STATUS and LOG_PAYMENT records only fill
+// sequence and status, which holds the payment state for LOG_PAYMENT
+typedef struct {
+    uint32_t type;
+    int32_t sequence;   // Order.sequence; the snapshot row number in older logs
+    int64_t orderTime;
+    int32_t quantity;
+    float totalAmount;
+    char customerName[50];
+    char itemName[50];
+    char status[20];
+} OrderLogRecord;
+
+typedef enum {
+    PERSIST_LOG_RECORD,     // one orders.log record
+    PERSIST_USER,           // a new users.txt line
+    PERSIST_USER_TABLE      // a full users.txt rewrite
+} PersistType;
+
+typedef struct {
+    uint8_t type; // PersistType
+    union {
+        OrderLogRecord record;
+        User user;
+        TextBuffer table;   // rows of users.txt, owned by the event
+    };
+} PersistEvent;
+
+// Producers reserve slots before taking any table lock, so they never block
+// while holding a lock the writer needs for compaction.
+typedef struct {
+    PersistEvent *events;
+    PersistEvent *batch;    // the writer's copy of the events it is writing
+    int head;
+    int count;
+    int reserved;           // slots promised to producers but not yet filled
+    uint64_t submitted;
+    uint64_t written;       // events on disk, or superseded by a snapshot
+    bool running;
+    bool stopping;
+} PersistQueue;
+
+// Settled payments also feed the notices shown at the terminal and the
+// throughput figures in the replay report.
+typedef struct {
+    Payment *pending;
+    int head;
+    int count;
+    int inFlight;           // taken by a worker, not yet settled
+    Payment notices[PAYMENT_NOTICE_SLOTS];
+    int noticeHead;
+    int noticeCount;
+    int paid;
+    int declined;
+    double firstSubmitted;
+    double lastSettled;
+    LatencySamples latency; // submit to settle, queueing included
+    int workerCount;
+    bool running;
+    bool stopping;
+} PaymentQueue;
+
+typedef enum {
+    METRIC_LOAD_USERS,
+    METRIC_LOAD_ORDERS,
+    METRIC_REPLAY_LOG,
+    METRIC_LOGIN,
+    METRIC_PLACE_ORDER,
+    METRIC_SET_STATUS,
+    METRIC_LOG_WRITE,
+    METRIC_SAVE_ORDERS,
+    METRIC_PAYMENT,
+    METRIC_COUNT
+} Metric;
+
+// Reads and writes count file transfers (a mapping, a sequential read, a flush
+// to the kernel) rather than stdio calls.
+typedef enum {
+    IO_OPEN,
+    IO_READ,
+    IO_WRITE,
+    IO_SYNC,
+    IO_RENAME,
+    IO_CALL_COUNT
+} IoCall;
+
+// Recorded from any thread with relaxed atomic adds
+typedef struct {
+    _Atomic uint64_t buckets[METRIC_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t totalNanos;
+    _Atomic uint64_t maxNanos;
+} Histogram;
+
+typedef struct {
+    Histogram operations[METRIC_COUNT];
+    _Atomic uint64_t ioCalls[IO_CALL_COUNT];
+    _Atomic uint64_t bytesRead;
+    _Atomic uint64_t bytesWritten;
+    uint64_t started;       // monotonicNanos at startup
+} Metrics;
+
+// Draws ranks 0..count-1 with probability proportional to 1/(rank+1) (Zipf),
+// so a few customers and dishes account for most orders
+typedef struct {
+    double *cdf;
+    int count;
+} ZipfTable;
+
+typedef struct {
+    int date;               // yyyymmdd, local time
+    time_t start;           // local midnight
+    time_t end;             // next local midnight
+    double revenue[24];
+    int orders[24];
+} SalesDay;
+
+typedef struct {
+    const char *name;       // interned
+    char category[20];
+    long long quantity;
+    double revenue;
+} ItemSales;
+
+// Struct-of-arrays copy of the order fields range scans read. Row i is order i;
+// after a failed allocation the columns stop growing and cover a prefix.
+typedef struct {
+    int64_t *orderTime;
+    float *totalAmount;
+    int *quantity;
+    int *item;              // index into SalesAnalytics.items
+    uint8_t *status;        // OrderStatus
+    int32_t *userId;
+    int count;
+    int capacity;
+} SalesColumns;
+
+// Scan kernels over SalesColumns; one set per instruction set, picked at startup.
+// Filters write matching row numbers to rows and return how many matched.
+typedef struct {
+    const char *name;
+    double (*sumAmount)(const float *amount, int count);
+    void (*countStatus)(const uint8_t *status, int count, int counts[STATUS_COUNT]);
+    int (*filterTime)(const int64_t *orderTime, int count, int64_t from, int64_t to, int *rows);
+    int (*filterCustomer)(const int32_t *userId, int count, int32_t customer, int *rows);
+} ColumnKernels;
+
+typedef struct {
+    SalesDay *days;         // sorted by start
+    int dayCount;
+    int dayCapacity;
+    ItemSales *items;
+    int itemCount;
+    int itemCapacity;
+    double *customerSpend;  // indexed by userId
+    int customerCapacity;
+    double unknownCustomerSpend;
+    SalesColumns columns;
+    int lastDay;            // day most recent orders fell into, -1 if none
+    bool incomplete;        // an allocation failed, figures undercount
+} SalesAnalytics;
+
+Arena tableArena;
+RecordStore userStore = { .arena = &tableArena, .recordSize = sizeof(User) };
+MenuSnapshot emptyMenu = { .freeHead = -1 };
+_Atomic(MenuSnapshot *) liveMenu = &emptyMenu;
+Arena nameArena;
+NameTable itemNames;
+Arena trieArena;
+TrieNode menuTrie;
+int kdfIterations = KDF_DEFAULT_ITERATIONS;
+RecordStore orderStore = { .arena = &tableArena, .recordSize = sizeof(Order) };
+HashIndex usernameIndex = { .keyOffset = offsetof(User, username) };
+HashIndex emailIndex = { .keyOffset = offsetof(User, email) };
+HashIndex phoneIndex = { .keyOffset = offsetof(User, phone) };
+TimeIndex orderTimeIndex;
+THREAD_LOCAL ClockCacheEntry clockCache[CLOCK_CACHE_SLOTS];
+bool plainOutput = false;       // stdout is not a terminal: drop escape sequences
+bool discardScreens = false;    // benchmarks build screens without writing them
+bool usersDirty = false;        // upgraded hashes not yet queued for users.txt
+time_t usersDirtySince;
 
 const char* USER_DB_FILE = "users.txt";
 const char* ORDER_DB_FILE = "orders.txt";
-const char* categories[MAX_CATEGORIES] = {"Bengali", "Pakistani", "Turkish"};
+const char* ORDER_LOG_FILE = "orders.log";
+const char* MENU_DB_FILE = "menu.dat";
+FILE *orderLog = NULL;
+int orderLogRecords = 0;
+int nextOrderSequence = 0;
+bool keepOrderSnapshot = false; // rows or log records were unusable: orders.txt is left for recovery
+PersistQueue persistQueue;
+PaymentQueue paymentQueue;
+MockGateway mockGateway = { PAYMENT_MOCK_LATENCY_MS, PAYMENT_MOCK_JITTER_MS, PAYMENT_MOCK_FAILURE_PERCENT };
+_Atomic uint64_t mockGatewaySeed;
+uint32_t crc32Table[256];
+bool metricsEnabled = false;    // set once at startup, before any thread starts
+const char *metricsPath = NULL;
+Metrics metrics;
+
+KitchenQueue processingQueue;   // tickets waiting to be cooked
+KitchenQueue readyQueue;        // dishes waiting to be delivered
+SalesAnalytics sales = { .lastDay = -1 };
+
+#ifndef _WIN32
+pthread_rwlock_t userLock = PTHREAD_RWLOCK_INITIALIZER;
+pthread_mutex_t menuWriteLock = PTHREAD_MUTEX_INITIALIZER;    // serializes menu edits
+pthread_mutex_t nameLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t credentialCacheLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t userSaveLock = PTHREAD_MUTEX_INITIALIZER;   // with a userLock reader, guards usersDirty
+pthread_rwlock_t orderLock = PTHREAD_RWLOCK_INITIALIZER;
+pthread_mutex_t orderLogLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t orderLogFileLock = PTHREAD_MUTEX_INITIALIZER;  // held while orders.log is written or swapped
+pthread_mutex_t persistLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t kitchenSpillLock = PTHREAD_MUTEX_INITIALIZER;  // guards both queues' spill lists
+pthread_cond_t persistWork = PTHREAD_COND_INITIALIZER;   // events queued or stopping
+pthread_cond_t persistSpace = PTHREAD_COND_INITIALIZER;  // slots freed
+pthread_cond_t persistDone = PTHREAD_COND_INITIALIZER;   // a batch reached the disk
+pthread_t persistThread;
+pthread_mutex_t paymentLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t paymentWork = PTHREAD_COND_INITIALIZER;   // payments queued or stopping
+pthread_cond_t paymentIdle = PTHREAD_COND_INITIALIZER;   // the queue ran dry
+pthread_t paymentThreads[PAYMENT_MAX_WORKERS];
+#endif
+const char* statusNames[STATUS_COUNT] = {"Processing", "Ready", "Delivered"};
+const char* paymentMethodNames[PAYMENT_METHOD_COUNT] = {"Cash", "BKash", "Rocket", "NAGAD", "VISA", "Mastercard"};
+const char* paymentStateNames[PAYMENT_STATE_COUNT] = {"Unpaid", "Pending", "Paid", "Declined"};
+const char* metricNames[METRIC_COUNT] = {"load_users", "load_orders", "replay_log", "login", "place_order",
+                                         "set_status", "log_write", "save_orders", "payment"};
+const char* ioCallNames[IO_CALL_COUNT] = {"open", "read", "write", "fsync", "rename"};
 
 // Function prototypes
+void *arenaAlloc(Arena *arena, size_t size);
+void *storeAt(const RecordStore *store, int index);
+void *storeAppend(RecordStore *store);
+User *userAt(int index);
+const char *internName(const char *text);
+NameEntry *nameEntryOf(const char *name);
+void setOrderItem(Order *order, const char *name);
+const MenuSnapshot *acquireMenu();
+const MenuSlot *menuSlotAt(const MenuSnapshot *menu, int slot);
+MenuItemId menuIdAt(const MenuSnapshot *menu, int slot);
+const MenuItem *menuItemById(const MenuSnapshot *menu, MenuItemId id);
+MenuSnapshot *buildMenu(int slotCount);
+void freeMenu(MenuSnapshot *menu);
+int findCategory(const MenuSnapshot *menu, const char *name, int *position);
+void indexItemWords(const char *name, MenuItemId id);
+int searchMenu(const MenuSnapshot *menu, const char *prefix, MenuItemId *found, int limit);
+void installMenu(MenuSnapshot *menu);
+bool publishMenu(MenuSnapshot *menu);
+MenuItemId addToMenu(const MenuItem *item);
+bool removeFromMenu(MenuItemId id);
+bool saveMenuToFile(const MenuSnapshot *menu);
+MenuSnapshot *loadMenuFromFile(bool *missing);
+Order *orderAt(int index);
+unsigned int hashString(const char *key);
+int hashIndexFind(const HashIndex *index, const char *key);
+bool hashIndexInsert(HashIndex *index, int userIndex);
+void hashIndexClear(HashIndex *index);
+bool indexUser(int userIndex);
+void linkCustomerOrder(int orderIndex);
+void clearCustomerOrders();
+bool textAppendf(TextBuffer *buffer, const char *format, ...);
+void textFlush(TextBuffer *buffer);
+void printColored(const char *format, ...);
+void initOutput();
+void renderText(const char *text);
+bool toLocalTime(time_t t, struct tm *local);
+void formatClockTime(time_t t, char text[9]);
+double monotonicSeconds();
+uint64_t monotonicNanos();
+void initMetrics();
+uint64_t metricStart();
+void metricStop(Metric metric, uint64_t start);
+void countIo(IoCall call, uint64_t bytes);
+bool dumpMetrics();
+bool recordLatency(LatencySamples *latency, double seconds);
+int benchmarkUserIndex(int userTotal);
+int benchmarkLoad(int orderTotal);
+void loadTables();
+int splitCommand(char *line, char *argv[]);
+const char *executeCommand(int argc, char *argv[], ReplayOp *op, char *detail);
+int runReplay(const char *path);
+int runServer(const char *socketPath, int threadCount);
+int runCommandLine(int argc, char *argv[]);
 void initializeMenu();
-void registerUser(char *role);
-int loginUser(char *role, char *username);
+const char *roleName(UserRole role);
+bool parseRole(const char *name, UserRole *role);
+bool parseOrderStatus(const char *name, OrderStatus *status);
+void registerUser(UserRole role);
+int loginUser(UserRole *role, char *username);
 void adminMenu(char *currentUsername);
 void customerMenu(char *currentUsername);
 void chefMenu(char *currentUsername);
@@ -86,14 +801,75 @@ void addMenuItem();
 void editMenuItem();
 void deleteMenuItem();
 void viewMenu();
+void showMenu(const MenuSnapshot *menu);
+void searchMenuItems();
+bool addUser(const User *user);
+void initPasswordHashing();
+bool hashPassword(const char *password, char *encoded);
+bool verifyPassword(const char *encoded, const char *password, bool *rehash);
+int benchmarkKdf(int targetMs);
+int benchmarkSuite(int userTotal, int itemTotal, int orderTotal);
+int createOrders(const char *username, const MenuSnapshot *menu, const CartLine *cart, int lineCount, float *total);
+bool setOrderStatus(int orderIndex, OrderStatus status);
+bool parsePaymentState(const char *name, PaymentState *state);
+void initPayments();
+bool startPayments();
+void stopPayments();
+bool submitPayment(int firstOrder, int orderCount, PaymentMethod method, const char **error);
+void settlePayment(Payment *payment, PaymentState state);
+void printPaymentNotices(const char *username);
+bool kitchenQueueInit(KitchenQueue *queue, size_t capacity);
+KitchenQueue *kitchenQueueFor(OrderStatus status);
+bool kitchenRingPush(KitchenQueue *queue, int orderIndex);
+bool kitchenRingPop(KitchenQueue *queue, int *orderIndex);
+bool kitchenSpill(KitchenQueue *queue, int orderIndex);
+bool kitchenPush(KitchenQueue *queue, int orderIndex);
+bool kitchenPop(KitchenQueue *queue, int *orderIndex);
+void rebuildKitchenQueues();
+bool advanceOrderStatus(int orderIndex, OrderStatus from, OrderStatus to);
+int completeNextTicket();
+int deliverNextOrder();
+void recordSale(int orderIndex);
+void rebuildSalesAnalytics();
+void viewSalesReports();
+void selectColumnKernels();
+int benchmarkColumns(int rowTotal);
 void placeOrder(char *currentUsername);
-void viewOrders(char *currentUserRole, char *currentUsername);
+bool growArray(void **array, int *capacity, int needed, size_t elementSize);
+int localDay(time_t t, time_t *start, time_t *end);
+bool timeIndexAppend(int orderIndex);
+void rebuildTimeIndex();
+int findOrdersFrom(time_t from);
+void appendOrderRow(TextBuffer *screen, int i);
+void viewOrderRange(int begin, int end, int page, int pages);
+void browseOrders();
+void viewOrders(UserRole currentUserRole, char *currentUsername);
 void updateOrderStatus();
-void processPayment(float total);
+void processPayment(int firstIndex, int lineCount, float total);
 void hidePassword(char *password);
 void saveUserToFile(User user);
-void saveOrderToFile(Order order);
+bool mapFile(const char *path, MappedFile *file);
+void unmapFile(MappedFile *file);
+bool readTextField(FieldReader *reader, char *dest, size_t destSize);
+bool readIntField(FieldReader *reader, long long *value);
+bool readAmountField(FieldReader *reader, float *value);
+bool parseOrderLine(FieldReader *reader, Order *order, const char **error);
+bool parseUserLine(FieldReader *reader, User *user, const char **error);
+bool nextLine(const char **cursor, const char *end, FieldReader *reader);
 void loadOrdersFromFile();
+int findOrderBySequence(int sequence);
+bool truncateFile(const char *path, long size);
+bool openOrderLog();
+void appendOrderLog(OrderLogType type, int firstIndex, int count);
+void reservePersist(int count);
+void releasePersist(int count);
+void submitPersist(const PersistEvent *event);
+bool startPersistence();
+void flushPersistence();
+void stopPersistence();
+bool compactOrderLog();
+bool compactionDue();
+void closeOrderLog();
 bool isEmailValid(const char *email);
 bool isPhoneValid(const char *phone);
 bool isPasswordValid(const char *password);
@@ -101,8 +877,17 @@ void loadUsersFromFile();
 bool isUsernameTaken(const char *username);
 bool isEmailTaken(const char *email);
 bool isPhoneTaken(const char *phone);
-void saveAllUsersToFile();
-void saveAllOrdersToFile();
+bool saveAllUsersToFile();
+void saveDirtyUsers(bool force);
+bool formatOrders(TextBuffer *body);
+bool writeOrderSnapshot(const TextBuffer *body);
+bool saveAllOrdersToFile();
+void initCrc32();
+uint32_t crc32(const void *data, size_t length);
+FILE *openTempFile(const char *path, char *tempPath, size_t size, const char *mode);
+bool commitTempFile(FILE *file, const char *tempPath, const char *path);
+bool writeTextFile(const char *path, const TextBuffer *body);
+bool checkFileHeader(const char *path, const char **cursor, const char *end, bool *damaged);
 int getNumericInput(int min, int max, const char *prompt);
 void forgotPassword();
 void generateOTP(char *otp);
@@ -112,12 +897,12 @@ void viewCustomerOrderHistory();
 void displayLogo();
 
 void displayLogo() {
-    printf(BROWN "=====================================\n");
-    printf("||                                    ||\n");
-    printf("||" GREEN "     RESTAURANT MANAGEMENT         " BROWN "||\n");
-    printf("||" CYAN  "           SYSTEM                  " BROWN "||\n");
-    printf("||                                   ||\n");
-    printf("=====================================" RESET "\n");
+    renderText(BROWN "=====================================\n"
+               "||                                    ||\n"
+               "||" GREEN "     RESTAURANT MANAGEMENT         " BROWN "||\n"
+               "||" CYAN  "           SYSTEM                  " BROWN "||\n"
+               "||                                   ||\n"
+               "=====================================" RESET "\n");
 }
 
 void clearInputBuffer() {
@@ -125,734 +910,5352 @@ void clearInputBuffer() {
     while ((c = getchar()) != '\n' && c != EOF);
 }
 
-void initializeMenu() {
-    // Bengali Items
-    strcpy(menu[0].name, "Plain Rice");
-    strcpy(menu[0].category, "Bengali");
-    menu[0].price = 50.0;
-    
-    // Pakistani Items
-    strcpy(menu[1].name, "Biryani");
-    strcpy(menu[1].category, "Pakistani");
-    menu[1].price = 180.0;
-    
-    // Turkish Items
-    strcpy(menu[2].name, "Doner");
-    strcpy(menu[2].category, "Turkish");
-    menu[2].price = 200.0;
-    
-    menuCount = 3;
-}
+void *arenaAlloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
 
-void loadOrdersFromFile() {
-    FILE *file = fopen(ORDER_DB_FILE, "r");
-    if (file == NULL) {
-        return;
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(ArenaBlock));
+        if (block == NULL) return NULL;
+        block->data = malloc(blockSize);
+        if (block->data == NULL) {
+            free(block);
+            return NULL;
+        }
+        block->used = 0;
+        block->size = blockSize;
+        block->next = arena->head;
+        arena->head = block;
     }
 
-    orderCount = 0;
-    while (fscanf(file, "%49[^,],%49[^,],%d,%19[^,],%f,%ld\n", 
-           orders[orderCount].customerName,
-           orders[orderCount].itemName,
-           &orders[orderCount].quantity,
-           orders[orderCount].status,
-           &orders[orderCount].totalAmount,
-           &orders[orderCount].orderTime) == 6) {
-        orderCount++;
-        if (orderCount >= MAX_ORDERS) break;
-    }
-    fclose(file);
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
 }
 
-void saveOrderToFile(Order order) {
-    FILE *file = fopen(ORDER_DB_FILE, "a");
-    if (file == NULL) {
-        printf(COLOR_RED "Error opening order database file!\n" COLOR_RESET);
-        return;
+void *storeAt(const RecordStore *store, int index) {
+    return store->chunks[index >> STORE_CHUNK_SHIFT] +
+           (size_t)(index & (STORE_CHUNK_RECORDS - 1)) * store->recordSize;
+}
+
+// Returns a zeroed slot at the end of the store, or NULL when out of memory.
+// Chunks survive a reset of count, so reloading a table reuses them.
+void *storeAppend(RecordStore *store) {
+    int chunk = store->count >> STORE_CHUNK_SHIFT;
+
+    if (chunk >= store->chunkCount) {
+        if (store->chunkCount == store->chunkCapacity) {
+            int newCapacity = store->chunkCapacity ? store->chunkCapacity * 2 : 8;
+            unsigned char **chunks = realloc(store->chunks, newCapacity * sizeof(*chunks));
+            if (chunks == NULL) return NULL;
+            store->chunks = chunks;
+            store->chunkCapacity = newCapacity;
+        }
+        unsigned char *records = arenaAlloc(store->arena, STORE_CHUNK_RECORDS * store->recordSize);
+        if (records == NULL) return NULL;
+        store->chunks[store->chunkCount++] = records;
     }
 
-    fprintf(file, "%s,%s,%d,%s,%.2f,%ld\n", 
-            order.customerName,
-            order.itemName,
-            order.quantity,
-            order.status,
-            order.totalAmount,
-            order.orderTime);
-    fclose(file);
+    void *slot = storeAt(store, store->count++);
+    memset(slot, 0, store->recordSize);
+    return slot;
 }
 
-void saveAllOrdersToFile() {
-    FILE *file = fopen(ORDER_DB_FILE, "w");
-    if (file == NULL) {
-        printf(COLOR_RED "Error opening order database file!\n" COLOR_RESET);
-        return;
-    }
+User *userAt(int index) {
+    return storeAt(&userStore, index);
+}
 
-    for (int i = 0; i < orderCount; i++) {
-        fprintf(file, "%s,%s,%d,%s,%.2f,%ld\n", 
-                orders[i].customerName,
-                orders[i].itemName,
-                orders[i].quantity,
-                orders[i].status,
-                orders[i].totalAmount,
-                orders[i].orderTime);
-    }
-    fclose(file);
+Order *orderAt(int index) {
+    return storeAt(&orderStore, index);
 }
 
-void hidePassword(char *password) {
-    char ch;
-    int i = 0;
-    memset(password, 0, 50);
-    
-#ifdef _WIN32
-    while ((ch = _getch()) != '\r') {
-        if (ch == '\b' && i > 0) {
-            printf("\b \b");
-            i--;
-            password[i] = '\0';
-        } else if (ch != '\b' && i < 49) {
-            password[i++] = ch;
-            printf("*");
-        }
+unsigned int hashString(const char *key) {
+    unsigned int hash = 2166136261u; // FNV-1a
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619u;
     }
-#else
-    struct termios oldt, newt;
-    tcgetattr(STDIN_FILENO, &oldt);
-    newt = oldt;
-    newt.c_lflag &= ~(ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+    return hash;
+}
 
-    while ((ch = getchar()) != '\n' && i < 49) {
-        if (ch == '\b' && i > 0) {
-            printf("\b \b");
-            i--;
-            password[i] = '\0';
-        } else if (ch != '\b') {
-            password[i++] = ch;
-            printf("*");
+int hashIndexFind(const HashIndex *index, const char *key) {
+    if (index->capacity == 0) return -1;
+
+    unsigned int hash = hashString(key);
+    int mask = index->capacity - 1;
+    for (int i = hash & mask; index->slots[i].record != 0; i = (i + 1) & mask) {
+        if (index->slots[i].hash == hash) {
+            int userIndex = index->slots[i].record - 1;
+            if (strcmp((const char *)userAt(userIndex) + index->keyOffset, key) == 0) {
+                return userIndex;
+            }
         }
     }
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-#endif
-    password[i] = '\0';
-    printf("\n");
+    return -1;
 }
 
-int getNumericInput(int min, int max, const char *prompt) {
-    int value;
-    while (1) {
-        printf("%s", prompt);
-        if (scanf("%d", &value) == 1 && value >= min && value <= max) {
-            clearInputBuffer();
-            return value;
-        }
-        printf(COLOR_RED "Invalid input! Please enter a number between %d and %d.\n" COLOR_RESET, min, max);
-        clearInputBuffer();
+bool hashIndexGrow(HashIndex *index) {
+    int newCapacity = index->capacity ? index->capacity * 2 : HASH_INDEX_MIN_CAPACITY;
+    HashSlot *slots = calloc(newCapacity, sizeof(HashSlot));
+    if (slots == NULL) return false;
+
+    int mask = newCapacity - 1;
+    for (int i = 0; i < index->capacity; i++) {
+        if (index->slots[i].record == 0) continue;
+        int j = index->slots[i].hash & mask;
+        while (slots[j].record != 0) j = (j + 1) & mask;
+        slots[j] = index->slots[i];
     }
+    free(index->slots);
+    index->slots = slots;
+    index->capacity = newCapacity;
+    return true;
 }
 
-void loadUsersFromFile() {
-    FILE *file = fopen(USER_DB_FILE, "r");
-    if (file == NULL) {
-        return;
+// Keeps the first user seen for a key, matching what the old linear scans returned.
+bool hashIndexInsert(HashIndex *index, int userIndex) {
+    if ((index->count + 1) * 100 > index->capacity * HASH_INDEX_MAX_LOAD_PERCENT) {
+        if (!hashIndexGrow(index)) return false;
     }
 
-    userCount = 0;
-    while (fscanf(file, "%49[^,],%99[^,],%14[^,],%49[^,],%19[^\n]\n", 
-           users[userCount].username, 
-           users[userCount].email, 
-           users[userCount].phone, 
-           users[userCount].password, 
-           users[userCount].role) == 5) {
-        userCount++;
-        if (userCount >= MAX_USERS) break;
+    const char *key = (const char *)userAt(userIndex) + index->keyOffset;
+    unsigned int hash = hashString(key);
+    int mask = index->capacity - 1;
+    int i = hash & mask;
+    for (; index->slots[i].record != 0; i = (i + 1) & mask) {
+        if (index->slots[i].hash == hash &&
+            strcmp((const char *)userAt(index->slots[i].record - 1) + index->keyOffset, key) == 0) {
+            return true;
+        }
     }
-    fclose(file);
+    index->slots[i].hash = hash;
+    index->slots[i].record = userIndex + 1;
+    index->count++;
+    return true;
 }
 
-void saveUserToFile(User user) {
-    FILE *file = fopen(USER_DB_FILE, "a");
-    if (file == NULL) {
-        printf(COLOR_RED "Error opening user database file!\n" COLOR_RESET);
-        return;
+void hashIndexClear(HashIndex *index) {
+    if (index->slots != NULL) {
+        memset(index->slots, 0, index->capacity * sizeof(HashSlot));
     }
+    index->count = 0;
+}
 
-    fprintf(file, "%s,%s,%s,%s,%s\n", 
-            user.username, 
-            user.email, 
-            user.phone, 
-            user.password, 
-            user.role);
-    fclose(file);
+bool indexUser(int userIndex) {
+    return hashIndexInsert(&usernameIndex, userIndex) &&
+           hashIndexInsert(&emailIndex, userIndex) &&
+           hashIndexInsert(&phoneIndex, userIndex);
 }
 
-void saveAllUsersToFile() {
-    FILE *file = fopen(USER_DB_FILE, "w");
-    if (file == NULL) {
-        printf(COLOR_RED "Error opening user database file!\n" COLOR_RESET);
-        return;
-    }
+// Appends an order to its customer's list. The list fields are guarded by the
+// order table lock, not the user table lock.
+void linkCustomerOrder(int orderIndex) {
+    Order *order = orderAt(orderIndex);
+    order->nextByCustomer = 0;
+    if (order->userId < 0) return;
 
-    for (int i = 0; i < userCount; i++) {
-        fprintf(file, "%s,%s,%s,%s,%s\n", 
-                users[i].username, 
-                users[i].email, 
-                users[i].phone, 
-                users[i].password, 
-                users[i].role);
+    User *user = userAt(order->userId);
+    if (user->lastOrder != 0) {
+        orderAt(user->lastOrder - 1)->nextByCustomer = orderIndex + 1;
+    } else {
+        user->firstOrder = orderIndex + 1;
     }
-    fclose(file);
+    user->lastOrder = orderIndex + 1;
 }
 
-bool isUsernameTaken(const char *username) {
-    for (int i = 0; i < userCount; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            return true;
-        }
+void clearCustomerOrders() {
+    for (int i = 0; i < userStore.count; i++) {
+        userAt(i)->firstOrder = 0;
+        userAt(i)->lastOrder = 0;
     }
-    return false;
 }
 
-bool isEmailTaken(const char *email) {
-    for (int i = 0; i < userCount; i++) {
-        if (strcmp(users[i].email, email) == 0) {
+bool textAppendf(TextBuffer *buffer, const char *format, ...) {
+    va_list args;
+    while (1) {
+        size_t available = buffer->capacity - buffer->length;
+        va_start(args, format);
+        int written = vsnprintf(buffer->data ? buffer->data + buffer->length : NULL, available, format, args);
+        va_end(args);
+        if (written < 0) return false;
+        if ((size_t)written < available) {
+            buffer->length += written;
             return true;
         }
+
+        size_t newCapacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while (newCapacity - buffer->length <= (size_t)written) newCapacity *= 2;
+        char *data = realloc(buffer->data, newCapacity);
+        if (data == NULL) return false;
+        buffer->data = data;
+        buffer->capacity = newCapacity;
     }
-    return false;
 }
 
-bool isPhoneTaken(const char *phone) {
-    for (int i = 0; i < userCount; i++) {
-        if (strcmp(users[i].phone, phone) == 0) {
-            return true;
-        }
-    }
-    return false;
+// Screens are built in a TextBuffer and emitted with textFlush, so a redraw is
+// one write however many rows it has.
+void initOutput() {
+#ifdef _WIN32
+    plainOutput = !_isatty(_fileno(stdout));
+#else
+    plainOutput = !isatty(STDOUT_FILENO);
+#endif
+    if (getenv("NO_COLOR") != NULL) plainOutput = true;
 }
 
-int userExists(char *username, char *password, char *role) {
-    for (int i = 0; i < userCount; i++) {
-        if (strcmp(users[i].username, username) == 0 && strcmp(users[i].password, password) == 0) {
-            strcpy(role, users[i].role);
-            return 1;
+// Removes ANSI escape sequences (ESC '[' parameters final-byte) in place.
+void stripEscapes(TextBuffer *buffer) {
+    size_t out = 0;
+    for (size_t i = 0; i < buffer->length; i++) {
+        if (buffer->data[i] == ESCAPE_CHAR && i + 1 < buffer->length && buffer->data[i + 1] == '[') {
+            i += 2;
+            while (i < buffer->length && (buffer->data[i] < 0x40 || buffer->data[i] > 0x7E)) i++;
+            continue;
         }
+        buffer->data[out++] = buffer->data[i];
     }
-    return 0;
+    buffer->length = out;
 }
 
-bool isEmailValid(const char *email) {
-    int atCount = 0, dotCount = 0;
-    int len = strlen(email);
-    if (len < 5) return false;
-
-    for (int i = 0; i < len; i++) {
-        if (email[i] == '@') atCount++;
-        if (email[i] == '.') dotCount++;
+// printf for status and error lines: drops colour codes on the same terms as
+// textFlush, so redirected output is plain throughout.
+void printColored(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (!plainOutput) {
+        vprintf(format, args);
+        va_end(args);
+        return;
     }
-    return (atCount == 1 && dotCount > 0);
+    char line[512];
+    TextBuffer text = {line, 0, sizeof(line)};
+    int written = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (written < 0) return;
+    if ((size_t)written >= sizeof(line)) {
+        text.data = malloc((size_t)written + 1);
+        if (text.data == NULL) return;
+        va_start(args, format);
+        vsnprintf(text.data, (size_t)written + 1, format, args);
+        va_end(args);
+    }
+    text.length = written;
+    stripEscapes(&text);
+    fwrite(text.data, 1, text.length, stdout);
+    if (text.data != line) free(text.data);
 }
 
-bool isPhoneValid(const char *phone) {
-    if (strlen(phone) != 11) return false;
-    for (int i = 0; i < 11; i++) {
-        if (!isdigit(phone[i])) return false;
+// Emits the whole buffer with one write and empties it for reuse.
+void textFlush(TextBuffer *buffer) {
+    if (discardScreens) {
+        buffer->length = 0;
+        return;
     }
-    return true;
+    if (plainOutput) stripEscapes(buffer);
+    fflush(stdout);
+#ifdef _WIN32
+    fwrite(buffer->data, 1, buffer->length, stdout);
+    fflush(stdout);
+#else
+    size_t offset = 0;
+    while (offset < buffer->length) {
+        ssize_t written = write(STDOUT_FILENO, buffer->data + offset, buffer->length - offset);
+        if (written <= 0) break;
+        offset += written;
+    }
+#endif
+    buffer->length = 0;
 }
 
-bool isPasswordValid(const char *password) {
-    bool hasDigit = false, hasSpecialChar = false;
-    if (strlen(password) < 8) return false;
-    for (int i = 0; i < strlen(password); i++) {
-        if (isdigit(password[i])) hasDigit = true;
-        if (ispunct(password[i])) hasSpecialChar = true;
+// Thread-safe replacement for localtime().
+bool toLocalTime(time_t t, struct tm *local) {
+#ifdef _WIN32
+    return localtime_s(local, &t) == 0;
+#else
+    return localtime_r(&t, local) != NULL;
+#endif
+}
+
+// Writes t as local "HH:MM:SS". Only the first timestamp seen in a minute pays
+// for the time zone conversion; the rest add their seconds to a cached prefix.
+void formatClockTime(time_t t, char text[9]) {
+    ClockCacheEntry *entry = &clockCache[(uint64_t)t / 60 % CLOCK_CACHE_SLOTS];
+    if (!entry->valid || t < entry->minuteStart || t - entry->minuteStart >= 60) {
+        struct tm local;
+        if (!toLocalTime(t, &local)) {
+            strcpy(text, "??:??:??");
+            return;
+        }
+        entry->minuteStart = t - local.tm_sec;
+        entry->prefix[0] = (char)('0' + local.tm_hour / 10);
+        entry->prefix[1] = (char)('0' + local.tm_hour % 10);
+        entry->prefix[2] = ':';
+        entry->prefix[3] = (char)('0' + local.tm_min / 10);
+        entry->prefix[4] = (char)('0' + local.tm_min % 10);
+        entry->prefix[5] = '\0';
+        entry->valid = true;
     }
-    return (hasDigit && hasSpecialChar);
+
+    int second = (int)(t - entry->minuteStart);
+    memcpy(text, entry->prefix, 5);
+    text[5] = ':';
+    text[6] = (char)('0' + second / 10);
+    text[7] = (char)('0' + second % 10);
+    text[8] = '\0';
 }
 
-void registerUser(char *role) {
-    if (userCount >= MAX_USERS) {
-        printf(COLOR_RED "User limit reached!\n" COLOR_RESET);
-        return;
+// Writes a fixed block of text, such as a menu, as a single screen.
+void renderText(const char *text) {
+    TextBuffer screen = {0};
+    textAppendf(&screen, "%s", text);
+    textFlush(&screen);
+    free(screen.data);
+}
+
+const char *roleName(UserRole role) {
+    switch (role) {
+        case ROLE_ADMIN: return "Admin";
+        case ROLE_CUSTOMER: return "Customer";
+        case ROLE_CHEF: return "Chef";
     }
+    return "Unknown";
+}
 
-    User newUser;
-    
-    while (1) {
-        printf("Enter username: ");
-        scanf("%49s", newUser.username);
-        clearInputBuffer();
-        if (isUsernameTaken(newUser.username)) {
-            printf(COLOR_RED "Username already taken! Please choose another.\n" COLOR_RESET);
-        } else {
-            break;
+bool parseRole(const char *name, UserRole *role) {
+    const UserRole roles[] = {ROLE_ADMIN, ROLE_CUSTOMER, ROLE_CHEF};
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(name, roleName(roles[i])) == 0) {
+            *role = roles[i];
+            return true;
         }
     }
+    return false;
+}
 
-    while (1) {
-        printf("Enter email: ");
-        scanf("%99s", newUser.email);
-        clearInputBuffer();
-        if (!isEmailValid(newUser.email)) {
-            printf(COLOR_RED "Invalid email format!\n" COLOR_RESET);
-        } else if (isEmailTaken(newUser.email)) {
-            printf(COLOR_RED "Email already registered! Please use another email.\n" COLOR_RESET);
-        } else {
-            break;
+bool parseOrderStatus(const char *name, OrderStatus *status) {
+    for (int i = 0; i < STATUS_COUNT; i++) {
+        if (strcmp(name, statusNames[i]) == 0) {
+            *status = i;
+            return true;
         }
     }
+    return false;
+}
 
-    while (1) {
-        printf("Enter phone (11 digits): ");
-        scanf("%14s", newUser.phone);
-        clearInputBuffer();
-        if (!isPhoneValid(newUser.phone)) {
-            printf(COLOR_RED "Phone number must be 11 digits!\n" COLOR_RESET);
-        } else if (isPhoneTaken(newUser.phone)) {
-            printf(COLOR_RED "Phone number already registered!\n" COLOR_RESET);
-        } else {
-            break;
+bool parsePaymentState(const char *name, PaymentState *state) {
+    for (int i = 0; i < PAYMENT_STATE_COUNT; i++) {
+        if (strcmp(name, paymentStateNames[i]) == 0) {
+            *state = i;
+            return true;
         }
     }
+    return false;
+}
 
-    char password[50];
-    while (1) {
-        printf("Enter password: ");
-        hidePassword(password);
-        if (!isPasswordValid(password)) {
-            printf(COLOR_RED "Password must be at least 8 characters long, contain a digit and a special character.\n" COLOR_RESET);
-        } else {
-            strcpy(newUser.password, password);
-            break;
+bool nameTableGrow(NameTable *table) {
+    int newCapacity = table->capacity ? table->capacity * 2 : HASH_INDEX_MIN_CAPACITY;
+    NameEntry **slots = calloc(newCapacity, sizeof(NameEntry *));
+    if (slots == NULL) return false;
+
+    int mask = newCapacity - 1;
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->slots[i] == NULL) continue;
+        int j = table->slots[i]->hash & mask;
+        while (slots[j] != NULL) j = (j + 1) & mask;
+        slots[j] = table->slots[i];
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = newCapacity;
+    return true;
+}
+
+// Returns the shared copy of text, adding it on first use, or NULL when out of
+// memory. Orders point at these copies instead of carrying the name.
+const char *internName(const char *text) {
+    unsigned int hash = hashString(text);
+    const char *interned = NULL;
+    MUTEX_LOCK(nameLock);
+    NameTable *table = &itemNames;
+    if ((table->count + 1) * 100 <= table->capacity * HASH_INDEX_MAX_LOAD_PERCENT || nameTableGrow(table)) {
+        int mask = table->capacity - 1;
+        int i = hash & mask;
+        while (table->slots[i] != NULL &&
+               (table->slots[i]->hash != hash || strcmp(table->slots[i]->text, text) != 0)) {
+            i = (i + 1) & mask;
+        }
+        if (table->slots[i] == NULL) {
+            size_t length = strlen(text);
+            NameEntry *entry = arenaAlloc(&nameArena, sizeof(NameEntry) + length + 1);
+            if (entry != NULL) {
+                entry->hash = hash;
+                entry->itemId = MENU_NO_ITEM;
+                entry->salesIndex = -1;
+                memcpy(entry->text, text, length + 1);
+                table->slots[i] = entry;
+                table->count++;
+            }
         }
+        if (table->slots[i] != NULL) interned = table->slots[i]->text;
     }
+    MUTEX_UNLOCK(nameLock);
+    return interned;
+}
 
-    strcpy(newUser.role, role);
-    users[userCount++] = newUser;
-    saveUserToFile(newUser);
+NameEntry *nameEntryOf(const char *name) {
+    return (NameEntry *)(name - offsetof(NameEntry, text));
+}
 
-    printf(COLOR_GREEN "Registration successful as %s!\n" COLOR_RESET, role);
+// Points a loaded order at its interned item name and the menu item of that
+// name, if one is still on the menu.
+void setOrderItem(Order *order, const char *name) {
+    order->itemName = name;
+    order->itemId = nameEntryOf(name)->itemId;
 }
 
-void generateOTP(char *otp) {
-    const char digits[] = "0123456789";
-    srand(time(0));
-    for (int i = 0; i < 6; i++) {
-        otp[i] = digits[rand() % 10];
-    }
-    otp[6] = '\0';
+const MenuSnapshot *acquireMenu() {
+    return atomic_load_explicit(&liveMenu, memory_order_acquire);
 }
 
-void sendDemoOTP(const char *email, const char *otp) {
-    printf(COLOR_BLUE "\nDemo Email Sent to: %s\n", email);
-    printf("Subject: Password Reset OTP\n");
-    printf("Message: Your OTP for password reset is: %s\n", otp);
-    printf("(In a real system, this would be sent via email)\n\n" COLOR_RESET);
+const MenuSlot *menuSlotAt(const MenuSnapshot *menu, int slot) {
+    return &menu->chunks[slot >> MENU_CHUNK_SHIFT][slot & (MENU_CHUNK_SLOTS - 1)];
 }
 
-void forgotPassword() {
-    char username[50], email[100], otp[7], userOTP[7];
-    int found = 0;
-    User *user = NULL;
-    
-    printf(COLOR_AQUA "\nForgot Password\n" COLOR_RESET);
-    printf("Enter your username: ");
-    scanf("%49s", username);
-    clearInputBuffer();
-    
-    printf("Enter your registered email: ");
-    scanf("%99s", email);
-    clearInputBuffer();
-    
-    // Find user with matching username and email
-    for (int i = 0; i < userCount; i++) {
-        if (strcmp(users[i].username, username) == 0 && strcmp(users[i].email, email) == 0) {
-            user = &users[i];
-            found = 1;
-            break;
+// Id of the live item in slot, or MENU_NO_ITEM for a tombstone or a bad slot.
+MenuItemId menuIdAt(const MenuSnapshot *menu, int slot) {
+    if (slot < 0 || slot >= menu->slotCount || !menuSlotAt(menu, slot)->live) return MENU_NO_ITEM;
+    return (MenuItemId)slot | menuSlotAt(menu, slot)->generation << MENU_SLOT_BITS;
+}
+
+const MenuItem *menuItemById(const MenuSnapshot *menu, MenuItemId id) {
+    if (id == MENU_NO_ITEM || (int)(id & MENU_SLOT_MASK) >= menu->slotCount) return NULL;
+    const MenuSlot *slot = menuSlotAt(menu, id & MENU_SLOT_MASK);
+    return slot->live && slot->generation == id >> MENU_SLOT_BITS ? &slot->item : NULL;
+}
+
+// Allocates a snapshot that owns all of its zeroed chunks, for loading a menu.
+// Callers fill the slots, then call linkFreeSlots.
+MenuSnapshot *buildMenu(int slotCount) {
+    int chunkCount = (slotCount + MENU_CHUNK_SLOTS - 1) >> MENU_CHUNK_SHIFT;
+    MenuSnapshot *menu = calloc(1, sizeof(MenuSnapshot));
+    if (menu == NULL) return NULL;
+    menu->chunks = calloc(chunkCount ? chunkCount : 1, sizeof(MenuSlot *));
+    for (int i = 0; menu->chunks != NULL && i < chunkCount; i++) {
+        menu->chunks[i] = calloc(MENU_CHUNK_SLOTS, sizeof(MenuSlot));
+        if (menu->chunks[i] == NULL) {
+            while (i-- > 0) free(menu->chunks[i]);
+            free(menu->chunks);
+            menu->chunks = NULL;
         }
     }
-    
-    if (!found) {
-        printf(COLOR_RED "No account found with that username and email combination.\n" COLOR_RESET);
-        return;
+    if (menu->chunks == NULL) {
+        free(menu);
+        return NULL;
     }
-    
-    // Generate and send OTP
-    generateOTP(otp);
-    sendDemoOTP(email, otp);
-    
-    printf("Enter the OTP sent to your email: ");
-    scanf("%6s", userOTP);
-    clearInputBuffer();
-    
-    if (strcmp(otp, userOTP) != 0) {
-        printf(COLOR_RED "Invalid OTP. Password reset failed.\n" COLOR_RESET);
-        return;
+    menu->slotCount = slotCount;
+    menu->freeHead = -1;
+    return menu;
+}
+
+// Frees a snapshot from buildMenu that was never installed, with the chunks and
+// category slot lists it owns.
+void freeMenu(MenuSnapshot *menu) {
+    if (menu == NULL) return;
+    int chunkCount = (menu->slotCount + MENU_CHUNK_SLOTS - 1) >> MENU_CHUNK_SHIFT;
+    for (int i = 0; i < chunkCount; i++) free(menu->chunks[i]);
+    for (int c = 0; c < menu->categoryCount; c++) free((int *)menu->categories[c].slots);
+    free(menu->chunks);
+    free(menu->categories);
+    free(menu);
+}
+
+// Binary search of the category directory; returns the category's index, or -1
+// with *position set to where it would be inserted.
+int findCategory(const MenuSnapshot *menu, const char *name, int *position) {
+    int low = 0, high = menu->categoryCount;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        int cmp = strcasecmp(menu->categories[mid].name, name);
+        if (cmp == 0) return mid;
+        if (cmp < 0) low = mid + 1; else high = mid;
     }
-    
-    // Get new password
-    char newPassword[50];
-    while (1) {
-        printf("Enter new password: ");
-        hidePassword(newPassword);
-        if (!isPasswordValid(newPassword)) {
-            printf(COLOR_RED "Password must be at least 8 characters long, contain a digit and a special character.\n" COLOR_RESET);
+    if (position != NULL) *position = low;
+    return -1;
+}
+
+// Builds the free list, live count and category index of a freshly built menu.
+// Returns false when out of memory.
+bool finishMenu(MenuSnapshot *menu) {
+    menu->liveCount = 0;
+    menu->freeHead = -1;
+    for (int i = menu->slotCount - 1; i >= 0; i--) {
+        MenuSlot *slot = (MenuSlot *)menuSlotAt(menu, i);
+        if (slot->live) {
+            menu->liveCount++;
+            slot->nextFree = -1;
         } else {
-            break;
+            slot->nextFree = menu->freeHead;
+            menu->freeHead = i;
         }
     }
-    
-    // Confirm password
-    char confirmPassword[50];
-    printf("Confirm new password: ");
-    hidePassword(confirmPassword);
-    
-    if (strcmp(newPassword, confirmPassword) != 0) {
-        printf(COLOR_RED "Passwords do not match. Password reset failed.\n" COLOR_RESET);
-        return;
+
+    // Count the items per category, then fill each category's slot list in order
+    int capacity = 0;
+    for (int i = 0; i < menu->slotCount; i++) {
+        const MenuSlot *slot = menuSlotAt(menu, i);
+        int position;
+        if (!slot->live) continue;
+        int c = findCategory(menu, slot->item.category, &position);
+        if (c < 0) {
+            if (!growArray((void **)&menu->categories, &capacity, menu->categoryCount + 1, sizeof(MenuCategory))) return false;
+            memmove(menu->categories + position + 1, menu->categories + position,
+                    (menu->categoryCount - position) * sizeof(MenuCategory));
+            memset(&menu->categories[position], 0, sizeof(MenuCategory));
+            strcpy(menu->categories[position].name, slot->item.category);
+            menu->categoryCount++;
+            c = position;
+        }
+        menu->categories[c].count++;
     }
-    
-    // Update password
-    strcpy(user->password, newPassword);
-    saveAllUsersToFile();
-    printf(COLOR_GREEN "Password reset successfully!\n" COLOR_RESET);
+    for (int c = 0; c < menu->categoryCount; c++) {
+        menu->categories[c].slots = malloc(menu->categories[c].count * sizeof(int));
+        if (menu->categories[c].slots == NULL) return false;
+        menu->categories[c].count = 0;
+    }
+    for (int i = 0; i < menu->slotCount; i++) {
+        const MenuSlot *slot = menuSlotAt(menu, i);
+        if (!slot->live) continue;
+        MenuCategory *category = &menu->categories[findCategory(menu, slot->item.category, NULL)];
+        ((int *)category->slots)[category->count++] = i;
+    }
+    return true;
 }
 
-int loginUser(char *role, char *username) {
-    char password[50] = {0};
-    int attempts = 0;
-    int choice;
-    
-    while (attempts < 3) {
-        printf("Enter username: ");
-        scanf("%49s", username);
-        clearInputBuffer();
-        
-        printf("Enter password: ");
-        hidePassword(password);
-        
-        if (userExists(username, password, role)) {
-            return 1;
-        }
-        
-        attempts++;
-        printf(COLOR_RED "Login failed. Invalid username or password.\n" COLOR_RESET);
-        
-        if (attempts == 2) {
-            printf("Forgot password? Press '1' to reset password: ");
-            scanf("%d",&choice);
-            clearInputBuffer();
-            if (choice == 1) {
-                forgotPassword();
-            }
-        }
+// Starts an edit of base: a snapshot sharing all of base's chunks and category
+// slot lists, with room in both directories for one more entry.
+MenuSnapshot *draftMenu(const MenuSnapshot *base) {
+    int usedChunks = (base->slotCount + MENU_CHUNK_SLOTS - 1) >> MENU_CHUNK_SHIFT;
+    MenuSnapshot *draft = malloc(sizeof(MenuSnapshot));
+    if (draft == NULL) return NULL;
+    *draft = *base;
+    draft->chunks = calloc((base->slotCount >> MENU_CHUNK_SHIFT) + 1, sizeof(MenuSlot *));
+    draft->categories = malloc((base->categoryCount + 1) * sizeof(MenuCategory));
+    if (draft->chunks == NULL || draft->categories == NULL) {
+        free(draft->chunks);
+        free(draft->categories);
+        free(draft);
+        return NULL;
     }
-    
-    printf(COLOR_RED "Too many failed attempts. Please try again later.\n" COLOR_RESET);
-    return 0;
+    memcpy(draft->chunks, base->chunks, usedChunks * sizeof(MenuSlot *));
+    memcpy(draft->categories, base->categories, base->categoryCount * sizeof(MenuCategory));
+    return draft;
 }
 
-void viewCustomerOrderHistory() {
-    if (orderCount == 0) {
-        printf(COLOR_YELLOW "\nNo orders have been placed yet.\n" COLOR_RESET);
-        return;
+// Gives the draft a new slot list for category with slot added or removed,
+// creating or dropping the category as needed. The new list is left in *copy.
+bool updateCategory(MenuSnapshot *draft, const char *name, int slot, bool add, int **copy) {
+    int position;
+    int c = findCategory(draft, name, &position);
+    if (c < 0) {
+        if (!add) return true;
+        memmove(draft->categories + position + 1, draft->categories + position,
+                (draft->categoryCount - position) * sizeof(MenuCategory));
+        memset(&draft->categories[position], 0, sizeof(MenuCategory));
+        strcpy(draft->categories[position].name, name);
+        draft->categoryCount++;
+        c = position;
+    }
+    MenuCategory *category = &draft->categories[c];
+    if (!add && category->count == 1) {
+        memmove(category, category + 1, (draft->categoryCount - c - 1) * sizeof(MenuCategory));
+        draft->categoryCount--;
+        return true;
     }
 
-    printf(COLOR_CORAL "\nCustomer Order History:\n" COLOR_RESET);
-    printf("----------------------------------------------------------------------------------------\n");
-    printf("Customer        Email                   Phone        Item            Quantity    Amount\n");
-    printf("----------------------------------------------------------------------------------------\n");
-    
-    for (int i = 0; i < orderCount; i++) {
-        char email[100] = "N/A";
-        char phone[15] = "N/A";
-        
-        for (int j = 0; j < userCount; j++) {
-            if (strcmp(users[j].username, orders[i].customerName) == 0) {
-                strcpy(email, users[j].email);
-                strcpy(phone, users[j].phone);
-                break;
-            }
-        }
-        
-        printf("%-15s %-24s %-12s %-15s %-11d %.2ftk\n", 
-               orders[i].customerName, 
-               email,
-               phone,
-               orders[i].itemName, 
-               orders[i].quantity,
-               orders[i].totalAmount);
+    *copy = malloc((category->count + (add ? 1 : -1)) * sizeof(int));
+    if (*copy == NULL) return false;
+    int count = 0;
+    for (int i = 0; i < category->count; i++) {
+        if (add && slot < category->slots[i] && count == i) (*copy)[count++] = slot;
+        if (category->slots[i] != slot) (*copy)[count++] = category->slots[i];
     }
-    printf("----------------------------------------------------------------------------------------\n");
+    if (add && count == category->count) (*copy)[count++] = slot;
+    category->slots = *copy;
+    category->count = count;
+    return true;
 }
 
-void adminMenu(char *currentUsername) {
-    int choice;
-    while (1) {
-        printf(COLOR_CORAL "\nAdmin Menu:\n" COLOR_RESET);
-        printf("1. Add Menu Item\n2. Delete Menu Item\n");
-        printf("3. View Menu\n4. View Orders\n5. View Customer Order History\n6. Logout\n");
-        choice = getNumericInput(1, 6, "Enter your choice: ");
-
-        switch (choice) {
-            case 1: addMenuItem(); break;
-            case 2: deleteMenuItem(); break;
-            case 3: viewMenu(); break;
-            case 4: viewOrders("Admin", currentUsername); break;
-            case 5: viewCustomerOrderHistory(); break;
-            case 6: return;
-            default: printf(COLOR_RED "Invalid choice\n" COLOR_RESET);
-        }
+// Gives a draft its own copy of the chunk holding slot and returns the slot.
+MenuSlot *writableSlot(MenuSnapshot *draft, int slot, MenuSlot **copy) {
+    int chunk = slot >> MENU_CHUNK_SHIFT;
+    *copy = malloc(MENU_CHUNK_SLOTS * sizeof(MenuSlot));
+    if (*copy == NULL) return NULL;
+    if (draft->chunks[chunk] != NULL) {
+        memcpy(*copy, draft->chunks[chunk], MENU_CHUNK_SLOTS * sizeof(MenuSlot));
+    } else {
+        memset(*copy, 0, MENU_CHUNK_SLOTS * sizeof(MenuSlot));
     }
+    draft->chunks[chunk] = *copy;
+    return &(*copy)[slot & (MENU_CHUNK_SLOTS - 1)];
 }
 
-void customerMenu(char *currentUsername) {
-    int choice;
-    while (1) {
-        printf(COLOR_CORAL "\nCustomer Menu:\n" COLOR_RESET);
-        printf("1. View Menu\n2. Place Order\n3. View Orders\n4. Logout\n");
-        choice = getNumericInput(1, 4, "Enter your choice: ");
+void discardDraft(MenuSnapshot *draft, MenuSlot *copy, int *slots) {
+    if (draft == NULL) return;
+    free(copy);
+    free(slots);
+    free(draft->chunks);
+    free(draft->categories);
+    free(draft);
+}
 
-        switch (choice) {
-            case 1: viewMenu(); break;
-            case 2: placeOrder(currentUsername); break;
-            case 3: viewOrders("Customer", currentUsername); break;
-            case 4: return;
-            default: printf(COLOR_RED "Invalid choice\n" COLOR_RESET);
-        }
-    }
+// Makes menu the live snapshot. The old one is only unlinked from the live
+// pointer, never freed.
+void installMenu(MenuSnapshot *menu) {
+    menu->retired = atomic_load_explicit(&liveMenu, memory_order_relaxed);
+    atomic_store_explicit(&liveMenu, menu, memory_order_release);
 }
 
-void chefMenu(char *currentUsername) {
-    int choice;
-    while (1) {
-        printf(COLOR_CORAL "\nChef Menu:\n" COLOR_RESET);
-        printf("1. View Orders\n2. Update Order Status\n3. Logout\n");
-        choice = getNumericInput(1, 3, "Enter your choice: ");
+// Saves an edited menu under the next version number and swaps it in. Callers
+// hold menuWriteLock; on failure the live menu is unchanged and menu is theirs.
+bool publishMenu(MenuSnapshot *menu) {
+    menu->version = acquireMenu()->version + 1;
+    if (!saveMenuToFile(menu)) return false;
+    installMenu(menu);
+    return true;
+}
 
-        switch (choice) {
-            case 1: viewOrders("Chef", currentUsername); break;
-            case 2: updateOrderStatus(); break;
-            case 3: return;
-            default: printf(COLOR_RED "Invalid choice\n" COLOR_RESET);
+// Puts item in the first free slot; returns its id, or MENU_NO_ITEM on failure.
+MenuItemId addToMenu(const MenuItem *item) {
+    MUTEX_LOCK(menuWriteLock);
+    const MenuSnapshot *base = acquireMenu();
+    int index = base->freeHead >= 0 ? base->freeHead : base->slotCount;
+    MenuItemId id = MENU_NO_ITEM;
+    MenuSlot *copy = NULL;
+    int *slots = NULL;
+    MenuSnapshot *draft = (unsigned int)index < MENU_SLOT_MASK ? draftMenu(base) : NULL;
+    MenuSlot *slot = draft != NULL ? writableSlot(draft, index, &copy) : NULL;
+    if (slot != NULL && updateCategory(draft, item->category, index, true, &slots)) {
+        if (index == base->slotCount) {
+            draft->slotCount++;
+        } else {
+            draft->freeHead = slot->nextFree;
+        }
+        slot->item = *item;
+        slot->live = true;
+        slot->nextFree = -1;
+        draft->liveCount++;
+        if (publishMenu(draft)) {
+            id = (MenuItemId)index | slot->generation << MENU_SLOT_BITS;
+            nameEntryOf(item->name)->itemId = id;
+            indexItemWords(item->name, id);
         }
     }
+    if (id == MENU_NO_ITEM) discardDraft(draft, copy, slots);
+    MUTEX_UNLOCK(menuWriteLock);
+    return id;
 }
 
-void addMenuItem() {
-    if (menuCount >= MAX_MENU_ITEMS) {
-        printf(COLOR_RED "Menu is full!\n" COLOR_RESET);
-        return;
+// Tombstones a live item in O(1): no other item moves or changes id. Returns
+// false if the item is already gone or the menu could not be saved.
+bool removeFromMenu(MenuItemId id) {
+    MUTEX_LOCK(menuWriteLock);
+    const MenuSnapshot *base = acquireMenu();
+    const MenuItem *item = menuItemById(base, id);
+    bool removed = false;
+    MenuSlot *copy = NULL;
+    int *slots = NULL;
+    MenuSnapshot *draft = item != NULL ? draftMenu(base) : NULL;
+    MenuSlot *slot = draft != NULL ? writableSlot(draft, id & MENU_SLOT_MASK, &copy) : NULL;
+    if (slot != NULL && updateCategory(draft, item->category, id & MENU_SLOT_MASK, false, &slots)) {
+        slot->live = false;
+        slot->generation = (slot->generation + 1) & MENU_GENERATION_MASK;
+        slot->nextFree = draft->freeHead;
+        draft->freeHead = id & MENU_SLOT_MASK;
+        draft->liveCount--;
+        removed = publishMenu(draft);
+        if (removed && nameEntryOf(slot->item.name)->itemId == id) {
+            nameEntryOf(slot->item.name)->itemId = MENU_NO_ITEM;
+        }
     }
+    if (!removed) discardDraft(draft, copy, slots);
+    MUTEX_UNLOCK(menuWriteLock);
+    return removed;
+}
 
-    printf("Enter item name: ");
-    char name[50];
-    scanf("%49[^\n]", name);
-    clearInputBuffer();
-    
-    printf("Select category:\n");
-    for (int i = 0; i < MAX_CATEGORIES; i++) {
-        printf("%d. %s\n", i+1, categories[i]);
+MenuSnapshot *defaultMenu() {
+    const char *names[] = {"Plain Rice", "Biryani", "Doner"};
+    MenuSnapshot *menu = buildMenu(3);
+    if (menu == NULL) return NULL;
+    menu->version = 1;
+
+    for (int i = 0; i < 3; i++) {
+        MenuSlot *slot = (MenuSlot *)menuSlotAt(menu, i);
+        slot->item.name = internName(names[i]);
+        slot->live = slot->item.name != NULL;
     }
-    int catChoice = getNumericInput(1, MAX_CATEGORIES, "Enter category number: ");
-    
-    printf("Enter item price: ");
-    float price;
-    scanf("%f", &price);
-    clearInputBuffer();
+    // Bengali Items
+    strcpy(((MenuSlot *)menuSlotAt(menu, 0))->item.category, "Bengali");
+    ((MenuSlot *)menuSlotAt(menu, 0))->item.price = 50.0;
     
-    strcpy(menu[menuCount].name, name);
-    strcpy(menu[menuCount].category, categories[catChoice-1]);
-    menu[menuCount].price = price;
+    // Pakistani Items
+    strcpy(((MenuSlot *)menuSlotAt(menu, 1))->item.category, "Pakistani");
+    ((MenuSlot *)menuSlotAt(menu, 1))->item.price = 180.0;
     
-    menuCount++;
-    printf(COLOR_GREEN "Menu item added successfully!\n" COLOR_RESET);
+    // Turkish Items
+    strcpy(((MenuSlot *)menuSlotAt(menu, 2))->item.category, "Turkish");
+    ((MenuSlot *)menuSlotAt(menu, 2))->item.price = 200.0;
+    return finishMenu(menu) ? menu : NULL;
 }
 
-void deleteMenuItem() {
-    viewMenu();
-    if (menuCount == 0) return;
-    
-    int itemNum = getNumericInput(1, menuCount, "Enter item number to delete: ");
-    
-    for (int i = itemNum-1; i < menuCount - 1; i++) {
-        menu[i] = menu[i + 1];
+// Adds the item under every word of its name, so "rice" finds "Plain Rice".
+// Callers hold menuWriteLock. Out of memory leaves the item out of searches.
+void indexItemWords(const char *name, MenuItemId id) {
+    for (int start = 0; name[start] != '\0'; start++) {
+        if (name[start] == ' ' || (start > 0 && name[start - 1] != ' ')) continue;
+
+        TrieNode *node = &menuTrie;
+        for (const char *c = name + start; *c != '\0' && node != NULL; c++) {
+            unsigned char key = tolower((unsigned char)*c);
+            _Atomic(TrieNode *) *link = &node->child;
+            TrieNode *next = atomic_load_explicit(link, memory_order_relaxed);
+            while (next != NULL && next->key < key) {
+                link = &next->sibling;
+                next = atomic_load_explicit(link, memory_order_relaxed);
+            }
+            if (next == NULL || next->key != key) {
+                TrieNode *fresh = arenaAlloc(&trieArena, sizeof(TrieNode));
+                if (fresh != NULL) {
+                    fresh->key = key;
+                    atomic_init(&fresh->child, NULL);
+                    atomic_init(&fresh->sibling, next);
+                    atomic_init(&fresh->items, NULL);
+                    atomic_store_explicit(link, fresh, memory_order_release);
+                }
+                next = fresh;
+            }
+            node = next;
+        }
+
+        TrieItem *item = node != NULL ? arenaAlloc(&trieArena, sizeof(TrieItem)) : NULL;
+        if (item == NULL) return;
+        item->id = id;
+        item->next = atomic_load_explicit(&node->items, memory_order_relaxed);
+        atomic_store_explicit(&node->items, item, memory_order_release);
     }
-    menuCount--;
-    printf(COLOR_GREEN "Menu item deleted successfully!\n" COLOR_RESET);
 }
 
-void viewMenu() {
-    printf(COLOR_CORAL "\nMenu Items:\n" COLOR_RESET);
-    printf("--------------------------------------------------\n");
-    printf("No.  Category     Item Name          Price\n");
-    printf("--------------------------------------------------\n");
-    for (int i = 0; i < menuCount; i++) {
-        printf("%-4d %-12s %-18s %.2ftk\n", i+1, menu[i].category, menu[i].name, menu[i].price);
+// Depth-first in key order, so results come out alphabetically by the matched
+// word. An item reached through two of its words is kept once.
+int collectItems(const TrieNode *node, const MenuSnapshot *menu, MenuItemId *found, int count, int limit) {
+    for (const TrieItem *item = atomic_load_explicit(&node->items, memory_order_acquire);
+         item != NULL && count < limit; item = item->next) {
+        if (menuItemById(menu, item->id) == NULL) continue;
+        int seen = 0;
+        while (seen < count && found[seen] != item->id) seen++;
+        if (seen == count) found[count++] = item->id;
+    }
+    for (const TrieNode *child = atomic_load_explicit(&node->child, memory_order_acquire);
+         child != NULL && count < limit; child = atomic_load_explicit(&child->sibling, memory_order_acquire)) {
+        count = collectItems(child, menu, found, count, limit);
     }
-    printf("--------------------------------------------------\n");
+    return count;
 }
 
-void placeOrder(char *currentUsername) {
-    viewMenu();
-    if (menuCount == 0) {
-        printf(COLOR_RED "No items available to order.\n" COLOR_RESET);
-        return;
+// Finds up to limit items of menu with a word starting with prefix, ignoring case.
+int searchMenu(const MenuSnapshot *menu, const char *prefix, MenuItemId *found, int limit) {
+    const TrieNode *node = &menuTrie;
+    for (const char *c = prefix; *c != '\0' && node != NULL; c++) {
+        unsigned char key = tolower((unsigned char)*c);
+        node = atomic_load_explicit(&node->child, memory_order_acquire);
+        while (node != NULL && node->key < key) node = atomic_load_explicit(&node->sibling, memory_order_acquire);
+        if (node != NULL && node->key != key) node = NULL;
     }
+    return node != NULL ? collectItems(node, menu, found, 0, limit) : 0;
+}
+
+// Records which live item each interned name belongs to, for resolving the
+// item names stored in orders.txt and orders.log, and indexes the names for search.
+void indexMenuNames(const MenuSnapshot *menu) {
+    for (int i = 0; i < menu->slotCount; i++) {
+        MenuItemId id = menuIdAt(menu, i);
+        if (id == MENU_NO_ITEM) continue;
+        nameEntryOf(menuSlotAt(menu, i)->item.name)->itemId = id;
+        indexItemWords(menuSlotAt(menu, i)->item.name, id);
+    }
+}
+
+void initCrc32() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) crc = crc & 1 ? crc >> 1 ^ 0xEDB88320u : crc >> 1;
+        crc32Table[i] = crc;
+    }
+}
+
+uint32_t crc32(const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) crc = crc32Table[(crc ^ bytes[i]) & 0xFF] ^ crc >> 8;
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Files are replaced whole: written to path.tmp, synced, then renamed over
+// path, so a crash leaves either the old file or the new one.
+FILE *openTempFile(const char *path, char *tempPath, size_t size, const char *mode) {
+    snprintf(tempPath, size, "%s.tmp", path);
+    FILE *file = fopen(tempPath, mode);
+    if (file != NULL) countIo(IO_OPEN, 0);
+    return file;
+}
+
+// Syncs and closes a file from openTempFile and renames it into place. The
+// directory is synced too, so the rename itself survives a power cut.
+bool commitTempFile(FILE *file, const char *tempPath, const char *path) {
+    bool ok = fflush(file) == 0;
+#ifdef _WIN32
+    ok = _commit(_fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    countIo(IO_SYNC, 0);
+    countIo(IO_RENAME, 0);
+#else
+    ok = fsync(fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(tempPath, path) == 0;
+    countIo(IO_SYNC, 0);
+    countIo(IO_RENAME, 0);
+    if (ok) {
+        char directory[256];
+        const char *slash = strrchr(path, '/');
+        snprintf(directory, sizeof(directory), "%.*s", slash ? (int)(slash - path) + 1 : 1, slash ? path : ".");
+        int fd = open(directory, O_RDONLY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+            countIo(IO_OPEN, 0);
+            countIo(IO_SYNC, 0);
+        }
+    }
+#endif
+    if (!ok) remove(tempPath);
+    return ok;
+}
+
+// Replaces a text table with body, behind a first line carrying the CRC-32 and
+// length of the rows written with it. Rows appended later (saveUserToFile)
+// follow the checked part and are validated one by one as before.
+bool writeTextFile(const char *path, const TextBuffer *body) {
+    char tempPath[256];
+    FILE *file = openTempFile(path, tempPath, sizeof(tempPath), "wb");
+    if (file == NULL) return false;
+    int headerLength = fprintf(file, "# crc32=%08x length=%zu\n", (unsigned int)crc32(body->data, body->length), body->length);
+    bool ok = headerLength > 0;
+    ok = (body->length == 0 || fwrite(body->data, 1, body->length, file) == body->length) && ok;
+    if (ok) countIo(IO_WRITE, headerLength + body->length);
+    if (!ok) {
+        fclose(file);
+        remove(tempPath);
+        return false;
+    }
+    return commitTempFile(file, tempPath, path);
+}
+
+// Steps over the checksum line of a text table and checks the rows it covers,
+// warning if they were cut short or changed. Files from before the header
+// load as they are. Returns true if a header line was consumed; *damaged is
+// set when the check fails.
+bool checkFileHeader(const char *path, const char **cursor, const char *end, bool *damaged) {
+    if (end - *cursor < 8 || memcmp(*cursor, "# crc32=", 8) != 0) return false;
+
+    char line[64];
+    const char *lineEnd = memchr(*cursor, '\n', end - *cursor);
+    if (lineEnd == NULL) lineEnd = end;
+    snprintf(line, sizeof(line), "%.*s", (int)(lineEnd - *cursor < 63 ? lineEnd - *cursor : 63), *cursor);
+    *cursor = lineEnd < end ? lineEnd + 1 : end;
+
+    unsigned int expected;
+    size_t length;
+    bool failed = true;
+    if (sscanf(line, "# crc32=%8x length=%zu", &expected, &length) != 2) {
+        printColored(COLOR_YELLOW "%s has an unreadable checksum line.\n" COLOR_RESET, path);
+    } else if ((size_t)(end - *cursor) < length) {
+        printColored(COLOR_YELLOW "%s is truncated: %zu of %zu bytes present.\n" COLOR_RESET, path, (size_t)(end - *cursor), length);
+    } else if (crc32(*cursor, length) != expected) {
+        printColored(COLOR_YELLOW "%s failed its checksum; loading the rows that still parse.\n" COLOR_RESET, path);
+    } else {
+        failed = false;
+    }
+    if (failed && damaged != NULL) *damaged = true;
+    return true;
+}
+
+// Writes the whole menu through a temporary file, so a crash leaves either the
+// old menu or the new one. Tombstones are written too, so item ids survive a
+// restart.
+bool saveMenuToFile(const MenuSnapshot *menu) {
+    char tempPath[256];
+    FILE *file = openTempFile(MENU_DB_FILE, tempPath, sizeof(tempPath), "wb");
+    if (file == NULL) {
+        printColored(COLOR_RED "Error opening menu file!\n" COLOR_RESET);
+        return false;
+    }
+
+    MenuFileHeader header = { MENU_FILE_MAGIC, MENU_FILE_VERSION, menu->version, menu->slotCount, sizeof(MenuFileRecord) };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < menu->slotCount; i++) {
+        const MenuSlot *slot = menuSlotAt(menu, i);
+        MenuFileRecord record;
+        memset(&record, 0, sizeof(record));
+        if (slot->item.name != NULL) {
+            snprintf(record.name, sizeof(record.name), "%s", slot->item.name);
+        }
+        strcpy(record.category, slot->item.category);
+        record.price = slot->item.price;
+        record.generation = slot->generation;
+        record.live = slot->live;
+        ok = fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+    if (!ok) {
+        fclose(file);
+        remove(tempPath);
+    }
+    if (ok) countIo(IO_WRITE, sizeof(header) + (uint64_t)menu->slotCount * sizeof(MenuFileRecord));
+    if (!ok || !commitTempFile(file, tempPath, MENU_DB_FILE)) {
+        printColored(COLOR_RED "Error writing menu file!\n" COLOR_RESET);
+        return false;
+    }
+    return true;
+}
+
+// Returns the saved menu, or NULL with *missing set when there is no menu file
+// and clear when the file is damaged.
+MenuSnapshot *loadMenuFromFile(bool *missing) {
+    FILE *file = fopen(MENU_DB_FILE, "rb");
+    *missing = file == NULL;
+    if (file == NULL) return NULL;
+    countIo(IO_OPEN, 0);
+
+    MenuFileHeader header;
+    MenuSnapshot *menu = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == MENU_FILE_MAGIC &&
+        ((header.formatVersion == MENU_FILE_VERSION && header.recordSize == sizeof(MenuFileRecord)) ||
+         (header.formatVersion == 1 && header.recordSize == sizeof(MenuFileRecordV1))) &&
+        header.itemCount < MENU_SLOT_MASK) {
+        menu = buildMenu(header.itemCount);
+    }
+    if (menu != NULL) {
+        menu->version = header.menuVersion;
+        for (int i = 0; i < menu->slotCount; i++) {
+            MenuFileRecord record;
+            memset(&record, 0, sizeof(record));
+            record.live = 1;
+            if (fread(&record, header.recordSize, 1, file) != 1) {
+                freeMenu(menu);
+                menu = NULL;
+                break;
+            }
+            record.name[sizeof(record.name) - 1] = '\0';
+            record.category[sizeof(record.category) - 1] = '\0';
+            MenuSlot *slot = (MenuSlot *)menuSlotAt(menu, i);
+            slot->item.name = internName(record.name);
+            strcpy(slot->item.category, record.category);
+            slot->item.price = record.price;
+            slot->generation = record.generation & MENU_GENERATION_MASK;
+            slot->live = record.live != 0 && slot->item.name != NULL;
+        }
+    }
+    if (menu != NULL && !finishMenu(menu)) {
+        freeMenu(menu);
+        menu = NULL;
+    }
+    countIo(IO_READ, ftell(file));
+    fclose(file);
+    return menu;
+}
+
+// Loads menu.dat, creating it from the default menu on first run.
+void initializeMenu() {
+    bool missing;
+    MenuSnapshot *menu = loadMenuFromFile(&missing);
+    if (menu == NULL) {
+        if (!missing) {
+            printColored(COLOR_RED "Menu file is damaged; using the default menu until it is edited.\n" COLOR_RESET);
+        }
+        menu = defaultMenu();
+        if (menu == NULL) {
+            printColored(COLOR_RED "Out of memory while loading the menu!\n" COLOR_RESET);
+            return;
+        }
+        if (missing) saveMenuToFile(menu);
+    }
+    installMenu(menu);
+    indexMenuNames(menu);
+}
+
+// Maps a data file read-only; on Windows the file is read into memory instead.
+bool mapFile(const char *path, MappedFile *file) {
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = false;
+
+#ifdef _WIN32
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size > 0) {
+        char *data = malloc(size);
+        if (data == NULL || fread(data, 1, size, fp) != (size_t)size) {
+            free(data);
+            fclose(fp);
+            return false;
+        }
+        file->data = data;
+        file->size = size;
+    }
+    fclose(fp);
+    countIo(IO_OPEN, 0);
+    countIo(IO_READ, file->size);
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    countIo(IO_OPEN, 0);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        file->data = data;
+        file->size = st.st_size;
+        file->mapped = true;
+        countIo(IO_READ, file->size);
+    }
+    close(fd);
+    return true;
+#endif
+}
+
+void unmapFile(MappedFile *file) {
+#ifndef _WIN32
+    if (file->mapped) {
+        munmap((void *)file->data, file->size);
+    } else
+#endif
+    free((void *)file->data);
+    file->data = NULL;
+    file->size = 0;
+}
+
+// Copies the next comma-separated field straight into its record; fails on an
+// empty field or one that does not fit destSize including the terminator.
+bool readTextField(FieldReader *reader, char *dest, size_t destSize) {
+    const char *start = reader->cursor;
+    const char *stop = memchr(start, ',', reader->end - start);
+    if (stop == NULL) stop = reader->end;
+
+    size_t length = stop - start;
+    if (length == 0 || length >= destSize) return false;
+    memcpy(dest, start, length);
+    dest[length] = '\0';
+    reader->cursor = stop < reader->end ? stop + 1 : stop;
+    return true;
+}
+
+bool readIntField(FieldReader *reader, long long *value) {
+    const char *p = reader->cursor;
+    bool negative = false;
+    if (p < reader->end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p == reader->end || !isdigit((unsigned char)*p)) return false;
+
+    long long result = 0;
+    while (p < reader->end && isdigit((unsigned char)*p)) {
+        result = result * 10 + (*p++ - '0');
+    }
+    if (p < reader->end && *p++ != ',') return false;
+    *value = negative ? -result : result;
+    reader->cursor = p;
+    return true;
+}
+
+bool readAmountField(FieldReader *reader, float *value) {
+    const char *p = reader->cursor;
+    if (p == reader->end || !isdigit((unsigned char)*p)) return false;
+
+    double result = 0;
+    while (p < reader->end && isdigit((unsigned char)*p)) {
+        result = result * 10 + (*p++ - '0');
+    }
+    if (p < reader->end && *p == '.') {
+        double scale = 0.1;
+        for (p++; p < reader->end && isdigit((unsigned char)*p); p++) {
+            result += (*p - '0') * scale;
+            scale /= 10;
+        }
+    }
+    if (p < reader->end && *p++ != ',') return false;
+    *value = (float)result;
+    reader->cursor = p;
+    return true;
+}
+
+bool parseOrderLine(FieldReader *reader, Order *order, const char **error) {
+    long long quantity, orderTime;
+    long long sequence = -1;    // older snapshots number orders by row
+    char itemName[50];
+    char status[20];
+    char payment[20];
+    OrderStatus parsedStatus;
+    PaymentState parsedPayment = PAYMENT_UNPAID; // older snapshots have no payment column
+
+    if (!readTextField(reader, order->customerName, sizeof(order->customerName))) {
+        *error = "customer name missing or too long";
+    } else if (!readTextField(reader, itemName, sizeof(itemName))) {
+        *error = "item name missing or too long";
+    } else if (!readIntField(reader, &quantity) || quantity <= 0 || quantity > 1000000) {
+        *error = "invalid quantity";
+    } else if (!readTextField(reader, status, sizeof(status)) || !parseOrderStatus(status, &parsedStatus)) {
+        *error = "unknown status";
+    } else if (!readAmountField(reader, &order->totalAmount)) {
+        *error = "invalid amount";
+    } else if (!readIntField(reader, &orderTime)) {
+        *error = "invalid order time";
+    } else if (reader->cursor != reader->end &&
+               (!readTextField(reader, payment, sizeof(payment)) || !parsePaymentState(payment, &parsedPayment))) {
+        *error = "unknown payment state";
+    } else if (reader->cursor != reader->end &&
+               (!readIntField(reader, &sequence) || reader->cursor != reader->end ||
+                sequence < 0 || sequence >= INT32_MAX)) {
+        *error = "invalid sequence number";
+    } else if ((order->itemName = internName(itemName)) == NULL) {
+        *error = "out of memory";
+    } else {
+        setOrderItem(order, order->itemName);
+        order->quantity = (int)quantity;
+        order->orderTime = (time_t)orderTime;
+        order->status = parsedStatus;
+        order->payment = parsedPayment;
+        order->sequence = (int)sequence;
+        return true;
+    }
+    return false;
+}
+
+bool parseUserLine(FieldReader *reader, User *user, const char **error) {
+    char role[20];
+    UserRole parsedRole;
+
+    if (!readTextField(reader, user->username, sizeof(user->username))) {
+        *error = "username missing or too long";
+    } else if (!readTextField(reader, user->email, sizeof(user->email))) {
+        *error = "email missing or too long";
+    } else if (!readTextField(reader, user->phone, sizeof(user->phone))) {
+        *error = "phone missing or too long";
+    } else if (!readTextField(reader, user->password, sizeof(user->password))) {
+        *error = "password missing or too long";
+    } else if (!readTextField(reader, role, sizeof(role)) || reader->cursor != reader->end ||
+               !parseRole(role, &parsedRole)) {
+        *error = "unknown role";
+    } else {
+        user->role = parsedRole;
+        return true;
+    }
+    return false;
+}
+
+// Splits the next line off *cursor; returns false at end of data.
+bool nextLine(const char **cursor, const char *end, FieldReader *reader) {
+    if (*cursor >= end) return false;
+
+    const char *lineEnd = memchr(*cursor, '\n', end - *cursor);
+    if (lineEnd == NULL) lineEnd = end;
+    reader->cursor = *cursor;
+    reader->end = lineEnd;
+    if (reader->end > reader->cursor && reader->end[-1] == '\r') reader->end--;
+    *cursor = lineEnd < end ? lineEnd + 1 : end;
+    return true;
+}
+
+// Rows carry the sequence number orders.log refers to them by; in older files
+// that is the row number, counting rows that fail to parse. Once a row has
+// been skipped or the checksum fails, orders.txt is kept as it is so the rows
+// can still be repaired.
+void loadOrdersFromFile() {
+    orderStore.count = 0;
+    nextOrderSequence = 0;
+    keepOrderSnapshot = false;
+    clearCustomerOrders();
+    MappedFile file;
+    if (!mapFile(ORDER_DB_FILE, &file)) {
+        return;
+    }
+
+    const char *cursor = file.data;
+    const char *end = file.data + file.size;
+    FieldReader reader;
+    const char *error;
+    int lineNumber = 0;
+    int rowNumber = 0;
+    if (checkFileHeader(ORDER_DB_FILE, &cursor, end, &keepOrderSnapshot)) lineNumber++;
+    while (nextLine(&cursor, end, &reader)) {
+        lineNumber++;
+        if (reader.cursor == reader.end) continue;
+        rowNumber++;
+
+        Order *order = storeAppend(&orderStore);
+        if (order == NULL) {
+            printColored(COLOR_RED "Out of memory while loading orders!\n" COLOR_RESET);
+            keepOrderSnapshot = true;
+            break;
+        }
+        if (!parseOrderLine(&reader, order, &error)) {
+            printColored(COLOR_YELLOW "%s line %d: %s; row skipped.\n" COLOR_RESET, ORDER_DB_FILE, lineNumber, error);
+            orderStore.count--;
+            keepOrderSnapshot = true;
+            continue;
+        }
+        if (order->sequence < 0) order->sequence = rowNumber - 1;
+        if (order->sequence < nextOrderSequence) {
+            printColored(COLOR_YELLOW "%s line %d: sequence number out of order; row skipped.\n" COLOR_RESET, ORDER_DB_FILE, lineNumber);
+            orderStore.count--;
+            keepOrderSnapshot = true;
+            continue;
+        }
+        nextOrderSequence = order->sequence + 1;
+        order->userId = hashIndexFind(&usernameIndex, order->customerName);
+        linkCustomerOrder(orderStore.count - 1);
+    }
+    unmapFile(&file);
+}
+
+// Appends every order as an orders.txt row. Callers hold orderLock, so the
+// rows are consistent; no disk I/O happens here.
+bool formatOrders(TextBuffer *body) {
+    bool ok = true;
+    for (int i = 0; ok && i < orderStore.count; i++) {
+        // A payment still with the provider is saved as unpaid; its result is
+        // logged when it settles
+        PaymentState payment = orderAt(i)->payment == PAYMENT_PENDING ? PAYMENT_UNPAID : orderAt(i)->payment;
+        ok = textAppendf(body, "%s,%s,%d,%s,%.2f,%ld,%s,%d\n", 
+                         orderAt(i)->customerName,
+                         orderAt(i)->itemName,
+                         orderAt(i)->quantity,
+                         statusNames[orderAt(i)->status],
+                         orderAt(i)->totalAmount,
+                         orderAt(i)->orderTime,
+                         paymentStateNames[payment],
+                         orderAt(i)->sequence);
+    }
+    return ok;
+}
+
+bool writeOrderSnapshot(const TextBuffer *body) {
+    uint64_t start = metricStart();
+    bool ok = writeTextFile(ORDER_DB_FILE, body);
+    if (!ok) printColored(COLOR_RED "Error writing order database file!\n" COLOR_RESET);
+    metricStop(METRIC_SAVE_ORDERS, start);
+    return ok;
+}
+
+bool saveAllOrdersToFile() {
+    TextBuffer body = {0};
+    bool ok = formatOrders(&body);
+    if (!ok) printColored(COLOR_RED "Out of memory! Order database not saved.\n" COLOR_RESET);
+    ok = ok && writeOrderSnapshot(&body);
+    free(body.data);
+    return ok;
+}
+
+bool startOrderLog(bool fresh) {
+    orderLog = fopen(ORDER_LOG_FILE, fresh ? "wb" : "ab");
+    if (orderLog == NULL) {
+        printColored(COLOR_RED "Error opening order log file!\n" COLOR_RESET);
+        return false;
+    }
+    countIo(IO_OPEN, 0);
+    setvbuf(orderLog, NULL, _IOFBF, ORDER_LOG_BUFFER);
+    if (fresh) {
+        OrderLogHeader header = { ORDER_LOG_MAGIC, ORDER_LOG_VERSION, sizeof(OrderLogRecord), 0 };
+        fwrite(&header, sizeof(header), 1, orderLog);
+        fflush(orderLog);
+        countIo(IO_WRITE, sizeof(header));
+    }
+    orderLogRecords = 0;
+    return true;
+}
+
+// The log keeps status names, so its format does not depend on enum values
+OrderStatus decodeLogStatus(const char *name) {
+    char status[20];
+    OrderStatus parsed;
+    memcpy(status, name, sizeof(status));
+    status[sizeof(status) - 1] = '\0';
+    return parseOrderStatus(status, &parsed) ? parsed : STATUS_PROCESSING;
+}
+
+PaymentState decodeLogPayment(const char *name) {
+    char state[20];
+    PaymentState parsed;
+    memcpy(state, name, sizeof(state));
+    state[sizeof(state) - 1] = '\0';
+    return parsePaymentState(state, &parsed) && parsed != PAYMENT_PENDING ? parsed : PAYMENT_UNPAID;
+}
+
+// Orders are appended in sequence order, so a binary search finds one. Returns
+// its index, or -1 if no loaded order has that number.
+int findOrderBySequence(int sequence) {
+    int low = 0, high = orderStore.count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (orderAt(mid)->sequence < sequence) low = mid + 1; else high = mid;
+    }
+    return low < orderStore.count && orderAt(low)->sequence == sequence ? low : -1;
+}
+
+// Cuts a torn record off the end of the log so appends stay record-aligned.
+bool truncateFile(const char *path, long size) {
+#ifdef _WIN32
+    FILE *file = fopen(path, "r+b");
+    bool ok = file != NULL && _chsize(_fileno(file), size) == 0;
+    if (file != NULL) fclose(file);
+    return ok;
+#else
+    return truncate(path, size) == 0;
+#endif
+}
+
+// Replays orders.log on top of the snapshot loaded from orders.txt, then keeps
+// the log open for appends. Records name orders by sequence number, so rows
+// skipped while loading do not shift the others. Orders the snapshot already
+// holds are skipped, so a crash between writing a snapshot and resetting the
+// log is harmless. Records matching no order are left in the log, and the
+// snapshot is then kept too, so nothing is lost before someone repairs it.
+bool openOrderLog() {
+    FILE *file = fopen(ORDER_LOG_FILE, "rb");
+    if (file == NULL) {
+        return startOrderLog(true);
+    }
+    countIo(IO_OPEN, 0);
+
+    OrderLogHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != ORDER_LOG_MAGIC ||
+        header.version != ORDER_LOG_VERSION ||
+        header.recordSize != sizeof(OrderLogRecord)) {
+        fclose(file);
+        printColored(COLOR_RED "Order log is not in a supported format; new orders will not be saved.\n" COLOR_RESET);
+        return false;
+    }
+
+    OrderLogRecord record;
+    int replayed = 0;
+    int unmatched = 0;
+    size_t got;
+    while ((got = fread(&record, 1, sizeof(record), file)) == sizeof(record)) {
+        int orderIndex = record.type == LOG_ORDER ? -1 : findOrderBySequence(record.sequence);
+        if (record.type == LOG_ORDER && record.sequence >= 0 && record.sequence < nextOrderSequence) {
+            // Already in the snapshot
+        } else if (record.type == LOG_ORDER && record.sequence >= 0 && record.sequence < INT32_MAX) {
+            Order *order = storeAppend(&orderStore);
+            if (order == NULL) {
+                printColored(COLOR_RED "Out of memory while replaying orders!\n" COLOR_RESET);
+                fclose(file);
+                return false;
+            }
+            const char *itemName;
+            record.itemName[sizeof(record.itemName) - 1] = '\0';
+            if ((itemName = internName(record.itemName)) == NULL) {
+                printColored(COLOR_RED "Out of memory while replaying orders!\n" COLOR_RESET);
+                fclose(file);
+                return false;
+            }
+            memcpy(order->customerName, record.customerName, sizeof(order->customerName));
+            order->customerName[sizeof(order->customerName) - 1] = '\0';
+            setOrderItem(order, itemName);
+            order->status = decodeLogStatus(record.status);
+            order->payment = PAYMENT_UNPAID;
+            order->quantity = record.quantity;
+            order->totalAmount = record.totalAmount;
+            order->orderTime = (time_t)record.orderTime;
+            order->sequence = record.sequence;
+            order->userId = hashIndexFind(&usernameIndex, order->customerName);
+            nextOrderSequence = record.sequence + 1;
+            linkCustomerOrder(orderStore.count - 1);
+        } else if (record.type == LOG_STATUS && orderIndex >= 0) {
+            orderAt(orderIndex)->status = decodeLogStatus(record.status);
+        } else if (record.type == LOG_PAYMENT && orderIndex >= 0) {
+            orderAt(orderIndex)->payment = decodeLogPayment(record.status);
+        } else {
+            unmatched++;
+            continue;
+        }
+        replayed++;
+    }
+    countIo(IO_READ, ftell(file));
+    fclose(file);
+
+    if (got != 0) {
+        // Torn record from an interrupted append
+        printColored(COLOR_YELLOW "Dropping a partial record at the end of the order log.\n" COLOR_RESET);
+        if (!truncateFile(ORDER_LOG_FILE, (long)(sizeof(header) + (size_t)(replayed + unmatched) * sizeof(record)))) {
+            printColored(COLOR_RED "Could not trim the order log; new orders will not be saved.\n" COLOR_RESET);
+            return false;
+        }
+    }
+    if (unmatched > 0) {
+        printColored(COLOR_YELLOW "%d order log records match no loaded order and were skipped.\n" COLOR_RESET, unmatched);
+        keepOrderSnapshot = true;
+    }
+    if (keepOrderSnapshot) {
+        printColored(COLOR_YELLOW "%s and %s are kept as they are for repair; changes are only appended to the log.\n" COLOR_RESET,
+                     ORDER_DB_FILE, ORDER_LOG_FILE);
+    }
+    if (!startOrderLog(false)) return false;
+    orderLogRecords = replayed + unmatched;
+    return true;
+}
+
+// Queues one log record for each of count consecutive orders. Callers hold the
+// locks that order the change and reserved the slots with reservePersist.
+void appendOrderLog(OrderLogType type, int firstIndex, int count) {
+    PersistEvent event;
+    for (int i = 0; i < count; i++) {
+        const Order *order = orderAt(firstIndex + i);
+        OrderLogRecord *record = &event.record;
+        memset(&event, 0, sizeof(event));
+        event.type = PERSIST_LOG_RECORD;
+        record->type = type;
+        record->sequence = order->sequence;
+        strcpy(record->status, type == LOG_PAYMENT ? paymentStateNames[order->payment] : statusNames[order->status]);
+        if (type == LOG_ORDER) {
+            memcpy(record->customerName, order->customerName, sizeof(record->customerName));
+            strcpy(record->itemName, order->itemName);
+            record->quantity = order->quantity;
+            record->totalAmount = order->totalAmount;
+            record->orderTime = order->orderTime;
+        }
+        submitPersist(&event);
+    }
+}
+
+// Folds the log into a fresh orders.txt snapshot and starts an empty log.
+// Callers hold orderLogFileLock and orderLogLock, or run without the writer
+// thread. If the snapshot
+// cannot be written, or is being kept for repair, the log is kept and false is
+// returned.
+bool compactOrderLog() {
+    if (keepOrderSnapshot) return false;
+    if (orderLog != NULL) {
+        fclose(orderLog);
+        orderLog = NULL;
+    }
+    if (!saveAllOrdersToFile()) {
+        int records = orderLogRecords;
+        if (startOrderLog(false)) orderLogRecords = records;
+        return false;
+    }
+    startOrderLog(true);
+    return true;
+}
+
+bool syncFile(FILE *file) {
+    if (fflush(file) != 0) return false;
+    countIo(IO_SYNC, 0);
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool appendUserLine(TextBuffer *buffer, const User *user) {
+    return textAppendf(buffer, "%s,%s,%s,%s,%s\n", 
+                       user->username, 
+                       user->email, 
+                       user->phone, 
+                       user->password, 
+                       roleName(user->role));
+}
+
+// Writes a batch with one write and one fsync per file.
+void writePersistBatch(PersistEvent *events, int count) {
+    uint64_t start = metricStart();
+    TextBuffer userLines = {0};
+    int records = 0;
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        PersistEvent *event = &events[i];
+        if (event->type == PERSIST_LOG_RECORD) {
+            if (orderLog == NULL) continue;
+            ok = fwrite(&event->record, sizeof(OrderLogRecord), 1, orderLog) == 1 && ok;
+            records++;
+        } else if (event->type == PERSIST_USER) {
+            if (!appendUserLine(&userLines, &event->user)) {
+                printColored(COLOR_RED "Out of memory! User %s was not saved.\n" COLOR_RESET, event->user.username);
+            }
+        } else {
+            // A rewrite holds every user, including the lines queued before it
+            userLines.length = 0;
+            if (!writeTextFile(USER_DB_FILE, &event->table)) {
+                printColored(COLOR_RED "Error writing user database file!\n" COLOR_RESET);
+            }
+            free(event->table.data);
+        }
+    }
+
+    if (userLines.length > 0) {
+        FILE *file = fopen(USER_DB_FILE, "a");
+        bool saved = file != NULL && fwrite(userLines.data, 1, userLines.length, file) == userLines.length;
+        if (file != NULL) countIo(IO_OPEN, 0);
+        if (saved) countIo(IO_WRITE, userLines.length);
+        saved = file != NULL && syncFile(file) && saved;
+        if (file != NULL) saved = fclose(file) == 0 && saved;
+        if (!saved) printColored(COLOR_RED "Error writing user database file!\n" COLOR_RESET);
+    }
+    free(userLines.data);
+
+    if (records > 0) {
+        countIo(IO_WRITE, (uint64_t)records * sizeof(OrderLogRecord));
+        if (!syncFile(orderLog) || !ok) printColored(COLOR_RED "Error writing order log file!\n" COLOR_RESET);
+        orderLogRecords += records;
+    }
+    metricStop(METRIC_LOG_WRITE, start);
+}
+
+// Blocks until count slots are free for the caller. Call before taking table
+// locks; every reserved slot is then filled by submitPersist or given back.
+void reservePersist(int count) {
+    if (!persistQueue.running) return;
+    MUTEX_LOCK(persistLock);
+    while (persistQueue.count + persistQueue.reserved + count > PERSIST_QUEUE_CAPACITY) {
+        COND_WAIT(persistSpace, persistLock);
+    }
+    persistQueue.reserved += count;
+    MUTEX_UNLOCK(persistLock);
+}
+
+void releasePersist(int count) {
+    if (!persistQueue.running) return;
+    MUTEX_LOCK(persistLock);
+    persistQueue.reserved -= count;
+    COND_BROADCAST(persistSpace);
+    MUTEX_UNLOCK(persistLock);
+}
+
+// Hands an event to the writer in a slot reserved earlier. Without a writer
+// thread (Windows, or before tables are loaded) the event is written at once.
+void submitPersist(const PersistEvent *event) {
+    if (!persistQueue.running) {
+        PersistEvent copy = *event;
+        writePersistBatch(&copy, 1);
+#ifdef _WIN32
+        // Locks are no-ops without threads, so compaction can run inline
+        if (compactionDue()) compactOrderLog();
+#endif
+        return;
+    }
+    MUTEX_LOCK(persistLock);
+    persistQueue.events[(persistQueue.head + persistQueue.count) % PERSIST_QUEUE_CAPACITY] = *event;
+    persistQueue.count++;
+    persistQueue.reserved--;
+    persistQueue.submitted++;
+    COND_BROADCAST(persistWork);
+    MUTEX_UNLOCK(persistLock);
+}
+
+// Moves every queued event into the writer's batch; with wait set, first
+// sleeps until there is one. Returns -1 once stopping with nothing left.
+int takePersistEvents(bool wait) {
+    MUTEX_LOCK(persistLock);
+    while (wait && persistQueue.count == 0 && !persistQueue.stopping) {
+        COND_WAIT(persistWork, persistLock);
+    }
+    int taken = persistQueue.count;
+    for (int i = 0; i < taken; i++) {
+        persistQueue.batch[i] = persistQueue.events[(persistQueue.head + i) % PERSIST_QUEUE_CAPACITY];
+    }
+    persistQueue.head = (persistQueue.head + taken) % PERSIST_QUEUE_CAPACITY;
+    persistQueue.count = 0;
+    if (taken > 0) COND_BROADCAST(persistSpace);
+    if (taken == 0 && persistQueue.stopping) taken = -1;
+    MUTEX_UNLOCK(persistLock);
+    return taken;
+}
+
+void finishPersistEvents(int count) {
+    MUTEX_LOCK(persistLock);
+    persistQueue.written += count;
+    COND_BROADCAST(persistDone);
+    MUTEX_UNLOCK(persistLock);
+}
+
+bool compactionDue() {
+    return orderLog != NULL && !keepOrderSnapshot &&
+           orderLogRecords > ORDER_LOG_COMPACT_MIN && orderLogRecords > orderStore.count;
+}
+
+// Compacts the log once it outgrows the snapshot, keeping appends amortized
+// O(1). Only formatting the snapshot happens under the order locks, which stop
+// every change, so it covers the log plus the records still queued. Those are
+// appended as usual, and since only the writer appends, the log then holds
+// exactly what the snapshot covers: it is reset once the snapshot is
+// committed, and left alone if writing it fails. Callers hold orderLogFileLock.
+void compactIfDue() {
+    TextBuffer body = {0};
+    int taken = 0;
+    READ_LOCK(orderLock);
+    bool due = compactionDue();
+    if (due) {
+        MUTEX_LOCK(orderLogLock);
+        taken = takePersistEvents(false);
+        due = formatOrders(&body);
+        MUTEX_UNLOCK(orderLogLock);
+    }
+    RW_UNLOCK(orderLock);
+
+    if (taken > 0) {
+        writePersistBatch(persistQueue.batch, taken);
+        finishPersistEvents(taken);
+    }
+    if (due && writeOrderSnapshot(&body)) {
+        closeOrderLog();
+        startOrderLog(true);
+    }
+    free(body.data);
+}
+
+#ifndef _WIN32
+// The only thread that writes orders.log and users.txt after startup. It
+// drains the ring in batches, so under load many changes share one write and
+// one fsync, and the UI and server threads never wait on the disk.
+void *persistWriter(void *arg) {
+    (void)arg;
+    int taken;
+    while ((taken = takePersistEvents(true)) >= 0) {
+        MUTEX_LOCK(orderLogFileLock);
+        writePersistBatch(persistQueue.batch, taken);
+        finishPersistEvents(taken);
+        compactIfDue();
+        MUTEX_UNLOCK(orderLogFileLock);
+    }
+    return NULL;
+}
+#endif
+
+bool startPersistence() {
+#ifdef _WIN32
+    return false;
+#else
+    persistQueue.events = malloc(PERSIST_QUEUE_CAPACITY * sizeof(PersistEvent));
+    persistQueue.batch = malloc(PERSIST_QUEUE_CAPACITY * sizeof(PersistEvent));
+    if (persistQueue.events == NULL || persistQueue.batch == NULL ||
+        pthread_create(&persistThread, NULL, persistWriter, NULL) != 0) {
+        free(persistQueue.events);
+        free(persistQueue.batch);
+        printColored(COLOR_YELLOW "Could not start the writer thread; saving synchronously.\n" COLOR_RESET);
+        return false;
+    }
+    persistQueue.running = true;
+    return true;
+#endif
+}
+
+// Barrier: returns once everything queued before the call is on disk.
+void flushPersistence() {
+    if (!persistQueue.running) return;
+    MUTEX_LOCK(persistLock);
+    uint64_t target = persistQueue.submitted;
+    while (persistQueue.written < target) COND_WAIT(persistDone, persistLock);
+    MUTEX_UNLOCK(persistLock);
+}
+
+// Saves any upgraded hashes, flushes and stops the writer thread, then closes
+// the log. Called at exit.
+void stopPersistence() {
+    saveDirtyUsers(true);
+    if (persistQueue.running) {
+        flushPersistence();
+        MUTEX_LOCK(persistLock);
+        persistQueue.stopping = true;
+        COND_BROADCAST(persistWork);
+        MUTEX_UNLOCK(persistLock);
+#ifndef _WIN32
+        pthread_join(persistThread, NULL);
+#endif
+        persistQueue.running = false;
+        free(persistQueue.events);
+        free(persistQueue.batch);
+    }
+    closeOrderLog();
+}
+
+void closeOrderLog() {
+    if (orderLog != NULL) {
+        fclose(orderLog);
+        orderLog = NULL;
+    }
+}
+
+void hidePassword(char *password) {
+    char ch;
+    int i = 0;
+    memset(password, 0, 50);
+    
+#ifdef _WIN32
+    while ((ch = _getch()) != '\r') {
+        if (ch == '\b' && i > 0) {
+            printf("\b \b");
+            i--;
+            password[i] = '\0';
+        } else if (ch != '\b' && i < 49) {
+            password[i++] = ch;
+            printf("*");
+        }
+    }
+#else
+    struct termios oldt, newt;
+    tcgetattr(STDIN_FILENO, &oldt);
+    newt = oldt;
+    newt.c_lflag &= ~(ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+
+    while ((ch = getchar()) != '\n' && i < 49) {
+        if (ch == '\b' && i > 0) {
+            printf("\b \b");
+            i--;
+            password[i] = '\0';
+        } else if (ch != '\b') {
+            password[i++] = ch;
+            printf("*");
+        }
+    }
+    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+#endif
+    password[i] = '\0';
+    printf("\n");
+}
+
+int getNumericInput(int min, int max, const char *prompt) {
+    int value;
+    while (1) {
+        printf("%s", prompt);
+        if (scanf("%d", &value) == 1 && value >= min && value <= max) {
+            clearInputBuffer();
+            return value;
+        }
+        printColored(COLOR_RED "Invalid input! Please enter a number between %d and %d.\n" COLOR_RESET, min, max);
+        clearInputBuffer();
+    }
+}
+
+void loadUsersFromFile() {
+    MappedFile file;
+    if (!mapFile(USER_DB_FILE, &file)) {
+        return;
+    }
+
+    const char *cursor = file.data;
+    const char *end = file.data + file.size;
+    FieldReader reader;
+    const char *error;
+    int lineNumber = 0;
+    userStore.count = 0;
+    hashIndexClear(&usernameIndex);
+    hashIndexClear(&emailIndex);
+    hashIndexClear(&phoneIndex);
+    if (checkFileHeader(USER_DB_FILE, &cursor, end, NULL)) lineNumber++;
+    while (nextLine(&cursor, end, &reader)) {
+        lineNumber++;
+        if (reader.cursor == reader.end) continue;
+
+        User *user = storeAppend(&userStore);
+        if (user == NULL) {
+            printColored(COLOR_RED "Out of memory while loading users!\n" COLOR_RESET);
+            break;
+        }
+        if (!parseUserLine(&reader, user, &error)) {
+            printColored(COLOR_YELLOW "%s line %d: %s; row skipped.\n" COLOR_RESET, USER_DB_FILE, lineNumber, error);
+            userStore.count--;
+            continue;
+        }
+        if (!indexUser(userStore.count - 1)) {
+            printColored(COLOR_RED "Out of memory while indexing users!\n" COLOR_RESET);
+            userStore.count--;
+            break;
+        }
+    }
+    unmapFile(&file);
+}
+
+// Queues the new user's line for the writer thread. The writer never takes
+// userLock, so callers may hold it while waiting for a slot.
+void saveUserToFile(User user) {
+    PersistEvent event;
+    event.type = PERSIST_USER;
+    event.user = user;
+    reservePersist(1);
+    submitPersist(&event);
+}
+
+// Queues a rewrite of users.txt with every user; callers hold userLock or run
+// single-threaded, so the rows are consistent.
+bool saveAllUsersToFile() {
+    PersistEvent event;
+    event.type = PERSIST_USER_TABLE;
+    memset(&event.table, 0, sizeof(event.table));
+    bool ok = true;
+    for (int i = 0; ok && i < userStore.count; i++) {
+        ok = appendUserLine(&event.table, userAt(i));
+    }
+    if (!ok) {
+        free(event.table.data);
+        printColored(COLOR_RED "Out of memory! User database not saved.\n" COLOR_RESET);
+        return false;
+    }
+    reservePersist(1);
+    submitPersist(&event);
+    usersDirty = false;
+    return true;
+}
+
+// Rehashing logins only mark the table dirty; this writes it once for all of
+// them, at most every USER_SAVE_DELAY_SECONDS unless forced at shutdown. A
+// userLock reader is enough to snapshot the rows, so logins are not blocked.
+void saveDirtyUsers(bool force) {
+    READ_LOCK(userLock);
+    MUTEX_LOCK(userSaveLock);
+    if (usersDirty && (force || time(NULL) - usersDirtySince >= USER_SAVE_DELAY_SECONDS)) {
+        saveAllUsersToFile();
+    }
+    MUTEX_UNLOCK(userSaveLock);
+    RW_UNLOCK(userLock);
+}
+
+bool isUsernameTaken(const char *username) {
+    return hashIndexFind(&usernameIndex, username) >= 0;
+}
+
+bool isEmailTaken(const char *email) {
+    return hashIndexFind(&emailIndex, email) >= 0;
+}
+
+bool isPhoneTaken(const char *phone) {
+    return hashIndexFind(&phoneIndex, phone) >= 0;
+}
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    size_t used;
+} Sha256;
+
+// Recently verified logins. The digest is an HMAC of the stored hash and the
+// password under a key made at startup, so a hit costs one SHA-256 instead of
+// a full key derivation, and changing the password invalidates the entry.
+typedef struct {
+    char username[50];
+    uint8_t digest[32];
+    time_t expires;
+} CredentialCacheEntry;
+
+const uint32_t sha256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+CredentialCacheEntry credentialCache[CREDENTIAL_CACHE_SLOTS];
+uint8_t credentialCacheKey[32];
+bool credentialCacheReady;
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void sha256Compress(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+               (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) +
+                      sha256RoundConstants[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256Init(Sha256 *sha) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(sha->state, initial, sizeof(initial));
+    sha->length = 0;
+    sha->used = 0;
+}
+
+void sha256Update(Sha256 *sha, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    sha->length += length;
+    while (length > 0) {
+        size_t take = 64 - sha->used < length ? 64 - sha->used : length;
+        memcpy(sha->block + sha->used, bytes, take);
+        sha->used += take;
+        bytes += take;
+        length -= take;
+        if (sha->used == 64) {
+            sha256Compress(sha->state, sha->block);
+            sha->used = 0;
+        }
+    }
+}
+
+void sha256Digest(const uint32_t state[8], uint8_t digest[32]) {
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = state[i] >> 24;
+        digest[4 * i + 1] = state[i] >> 16;
+        digest[4 * i + 2] = state[i] >> 8;
+        digest[4 * i + 3] = state[i];
+    }
+}
+
+void sha256Final(Sha256 *sha, uint8_t digest[32]) {
+    uint64_t bits = sha->length * 8;
+    uint8_t pad = 0x80;
+    sha256Update(sha, &pad, 1);
+    pad = 0;
+    while (sha->used != 56) sha256Update(sha, &pad, 1);
+    for (int i = 7; i >= 0; i--) {
+        uint8_t byte = bits >> (8 * i);
+        sha256Update(sha, &byte, 1);
+    }
+    sha256Digest(sha->state, digest);
+}
+
+// Hashes the HMAC key into the inner and outer states once, so each HMAC of a
+// 32-byte message afterwards costs two compressions.
+void hmacSha256Keys(const uint8_t *key, size_t keyLength, Sha256 *inner, Sha256 *outer) {
+    uint8_t pad[64] = {0};
+    if (keyLength > 64) {
+        Sha256 sha;
+        sha256Init(&sha);
+        sha256Update(&sha, key, keyLength);
+        sha256Final(&sha, pad);
+    } else {
+        memcpy(pad, key, keyLength);
+    }
+    for (int i = 0; i < 64; i++) pad[i] ^= 0x36;
+    sha256Init(inner);
+    sha256Update(inner, pad, 64);
+    for (int i = 0; i < 64; i++) pad[i] ^= 0x36 ^ 0x5c;
+    sha256Init(outer);
+    sha256Update(outer, pad, 64);
+}
+
+void hmacSha256Finish(const Sha256 *outer, Sha256 *inner, uint8_t mac[32]) {
+    Sha256 sha = *outer;
+    sha256Final(inner, mac);
+    sha256Update(&sha, mac, 32);
+    sha256Final(&sha, mac);
+}
+
+// PBKDF2-HMAC-SHA256 with a single 32-byte output block.
+void pbkdf2Sha256(const char *password, const uint8_t *salt, size_t saltLength, int iterations, uint8_t out[32]) {
+    Sha256 inner, outer, sha;
+    hmacSha256Keys((const uint8_t *)password, strlen(password), &inner, &outer);
+
+    static const uint8_t blockIndex[4] = {0, 0, 0, 1};
+    uint8_t u[32];
+    sha = inner;
+    sha256Update(&sha, salt, saltLength);
+    sha256Update(&sha, blockIndex, 4);
+    hmacSha256Finish(&outer, &sha, u);
+    memcpy(out, u, 32);
+
+    // Later rounds hash exactly 32 bytes after the 64-byte key block, so the
+    // padded block is laid out once and only the message part changes.
+    uint8_t block[64] = {0};
+    block[32] = 0x80;
+    block[62] = (64 + 32) * 8 >> 8;
+    block[63] = (uint8_t)((64 + 32) * 8);
+    for (int round = 1; round < iterations; round++) {
+        uint32_t state[8];
+        memcpy(block, u, 32);
+        memcpy(state, inner.state, sizeof(state));
+        sha256Compress(state, block);
+        sha256Digest(state, block);
+        memcpy(state, outer.state, sizeof(state));
+        sha256Compress(state, block);
+        sha256Digest(state, u);
+        for (int i = 0; i < 32; i++) out[i] ^= u[i];
+    }
+}
+
+bool randomBytes(uint8_t *buffer, size_t length) {
+#ifdef _WIN32
+    for (size_t i = 0; i < length; i++) {
+        unsigned int value;
+        if (rand_s(&value) != 0) return false;
+        buffer[i] = (uint8_t)value;
+    }
+    return true;
+#else
+    FILE *source = fopen("/dev/urandom", "rb");
+    if (source == NULL) return false;
+    bool ok = fread(buffer, 1, length, source) == length;
+    fclose(source);
+    return ok;
+#endif
+}
+
+void hexEncode(const uint8_t *bytes, size_t length, char *text) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+        text[2 * i] = digits[bytes[i] >> 4];
+        text[2 * i + 1] = digits[bytes[i] & 15];
+    }
+    text[2 * length] = '\0';
+}
+
+// Decodes exactly length bytes of hex from text; returns the end of the hex or NULL.
+const char *hexDecode(const char *text, uint8_t *bytes, size_t length) {
+    for (size_t i = 0; i < 2 * length; i++) {
+        int c = tolower((unsigned char)text[i]);
+        int value = isdigit(c) ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (value < 0) return NULL;
+        if (i % 2 == 0) bytes[i / 2] = value << 4; else bytes[i / 2] |= value;
+    }
+    return text + 2 * length;
+}
+
+// Compares without an early exit, so the time taken does not reveal how much matched.
+bool equalBytes(const uint8_t *a, const uint8_t *b, size_t length) {
+    uint8_t difference = 0;
+    for (size_t i = 0; i < length; i++) difference |= a[i] ^ b[i];
+    return difference == 0;
+}
+
+// Reads the work factor from KDF_ITERATIONS and makes the credential cache key.
+void initPasswordHashing() {
+    const char *iterations = getenv("KDF_ITERATIONS");
+    if (iterations != NULL) {
+        long value = strtol(iterations, NULL, 10);
+        if (value >= KDF_MIN_ITERATIONS && value <= KDF_MAX_ITERATIONS) {
+            kdfIterations = (int)value;
+        } else {
+            fprintf(stderr, "KDF_ITERATIONS must be %d-%d; using %d.\n", KDF_MIN_ITERATIONS, KDF_MAX_ITERATIONS, kdfIterations);
+        }
+    }
+    credentialCacheReady = randomBytes(credentialCacheKey, sizeof(credentialCacheKey));
+}
+
+// Writes a fresh salted hash of password to encoded (PASSWORD_HASH_LENGTH bytes).
+bool hashPassword(const char *password, char *encoded) {
+    uint8_t salt[PASSWORD_SALT_BYTES], hash[32];
+    char saltText[2 * PASSWORD_SALT_BYTES + 1], hashText[65];
+    if (!randomBytes(salt, sizeof(salt))) return false;
+    pbkdf2Sha256(password, salt, sizeof(salt), kdfIterations, hash);
+    hexEncode(salt, sizeof(salt), saltText);
+    hexEncode(hash, sizeof(hash), hashText);
+    snprintf(encoded, PASSWORD_HASH_LENGTH, "pbkdf2$%d$%s$%s", kdfIterations, saltText, hashText);
+    return true;
+}
+
+// Checks password against a stored credential. *rehash is set when it should be
+// stored again: it is still plaintext or uses fewer iterations than configured.
+bool verifyPassword(const char *encoded, const char *password, bool *rehash) {
+    if (strncmp(encoded, "pbkdf2$", 7) != 0) {
+        *rehash = true;
+        size_t length = strlen(encoded);
+        return length == strlen(password) && equalBytes((const uint8_t *)encoded, (const uint8_t *)password, length);
+    }
+
+    char *cursor;
+    long iterations = strtol(encoded + 7, &cursor, 10);
+    uint8_t salt[PASSWORD_SALT_BYTES], expected[32], hash[32];
+    if (iterations < 1 || iterations > KDF_MAX_ITERATIONS || *cursor != '$' ||
+        (cursor = (char *)hexDecode(cursor + 1, salt, sizeof(salt))) == NULL || *cursor != '$' ||
+        (cursor = (char *)hexDecode(cursor + 1, expected, sizeof(expected))) == NULL || *cursor != '\0') {
+        *rehash = false;
+        return false;
+    }
+    *rehash = iterations < kdfIterations;
+    pbkdf2Sha256(password, salt, sizeof(salt), (int)iterations, hash);
+    return equalBytes(hash, expected, sizeof(hash));
+}
+
+void credentialDigest(const char *encoded, const char *password, uint8_t digest[32]) {
+    Sha256 inner, outer;
+    hmacSha256Keys(credentialCacheKey, sizeof(credentialCacheKey), &inner, &outer);
+    sha256Update(&inner, encoded, strlen(encoded) + 1);
+    sha256Update(&inner, password, strlen(password));
+    hmacSha256Finish(&outer, &inner, digest);
+}
+
+CredentialCacheEntry *credentialSlot(const char *username) {
+    return &credentialCache[hashString(username) & (CREDENTIAL_CACHE_SLOTS - 1)];
+}
+
+bool credentialCached(const char *username, const uint8_t digest[32]) {
+    MUTEX_LOCK(credentialCacheLock);
+    const CredentialCacheEntry *entry = credentialSlot(username);
+    bool hit = entry->expires > time(NULL) && strcmp(entry->username, username) == 0 &&
+               equalBytes(entry->digest, digest, 32);
+    MUTEX_UNLOCK(credentialCacheLock);
+    return hit;
+}
+
+void cacheCredential(const char *username, const uint8_t digest[32]) {
+    MUTEX_LOCK(credentialCacheLock);
+    CredentialCacheEntry *entry = credentialSlot(username);
+    strcpy(entry->username, username);
+    memcpy(entry->digest, digest, 32);
+    entry->expires = time(NULL) + CREDENTIAL_CACHE_SECONDS;
+    MUTEX_UNLOCK(credentialCacheLock);
+}
+
+// Checks a login and takes userLock itself: the key derivation runs outside the
+// lock so a slow hash does not stall other sessions. Plaintext and weaker
+// hashes are replaced with a current one after a successful login.
+int checkLogin(char *username, char *password, UserRole *role) {
+    char stored[PASSWORD_HASH_LENGTH];
+    READ_LOCK(userLock);
+    int i = hashIndexFind(&usernameIndex, username);
+    if (i >= 0) {
+        strcpy(stored, userAt(i)->password);
+        *role = userAt(i)->role;
+    }
+    RW_UNLOCK(userLock);
+    if (i < 0) return 0;
+
+    uint8_t digest[32];
+    if (credentialCacheReady) {
+        credentialDigest(stored, password, digest);
+        if (credentialCached(username, digest)) return 1;
+    }
+
+    bool rehash;
+    if (!verifyPassword(stored, password, &rehash)) return 0;
+    char upgraded[PASSWORD_HASH_LENGTH];
+    if (rehash && hashPassword(password, upgraded)) {
+        WRITE_LOCK(userLock);
+        if (strcmp(userAt(i)->password, stored) == 0) {
+            strcpy(userAt(i)->password, upgraded);
+            strcpy(stored, upgraded);
+            if (!usersDirty) usersDirtySince = time(NULL);
+            usersDirty = true;
+        }
+        RW_UNLOCK(userLock);
+        saveDirtyUsers(false);
+        if (credentialCacheReady) credentialDigest(stored, password, digest);
+    }
+    if (credentialCacheReady) cacheCredential(username, digest);
+    return 1;
+}
+
+int userExists(char *username, char *password, UserRole *role) {
+    uint64_t start = metricStart();
+    int found = checkLogin(username, password, role);
+    metricStop(METRIC_LOGIN, start);
+    return found;
+}
+
+bool isEmailValid(const char *email) {
+    int atCount = 0, dotCount = 0;
+    int len = strlen(email);
+    if (len < 5) return false;
+
+    for (int i = 0; i < len; i++) {
+        if (email[i] == '@') atCount++;
+        if (email[i] == '.') dotCount++;
+    }
+    return (atCount == 1 && dotCount > 0);
+}
+
+bool isPhoneValid(const char *phone) {
+    if (strlen(phone) != 11) return false;
+    for (int i = 0; i < 11; i++) {
+        if (!isdigit(phone[i])) return false;
+    }
+    return true;
+}
+
+bool isPasswordValid(const char *password) {
+    bool hasDigit = false, hasSpecialChar = false;
+    if (strlen(password) < 8) return false;
+    for (int i = 0; i < strlen(password); i++) {
+        if (isdigit(password[i])) hasDigit = true;
+        if (ispunct(password[i])) hasSpecialChar = true;
+    }
+    return (hasDigit && hasSpecialChar);
+}
+
+// Appends an already validated user to the table, its indexes and users.txt.
+bool addUser(const User *user) {
+    User *slot = storeAppend(&userStore);
+    if (slot == NULL) return false;
+    *slot = *user;
+    slot->firstOrder = slot->lastOrder = 0;
+    if (!indexUser(userStore.count - 1)) {
+        userStore.count--;
+        return false;
+    }
+    saveUserToFile(*user);
+    return true;
+}
+
+void registerUser(UserRole role) {
+    User newUser;
+    
+    while (1) {
+        printf("Enter username: ");
+        scanf("%49s", newUser.username);
+        clearInputBuffer();
+        if (isUsernameTaken(newUser.username)) {
+            printColored(COLOR_RED "Username already taken! Please choose another.\n" COLOR_RESET);
+        } else {
+            break;
+        }
+    }
+
+    while (1) {
+        printf("Enter email: ");
+        scanf("%99s", newUser.email);
+        clearInputBuffer();
+        if (!isEmailValid(newUser.email)) {
+            printColored(COLOR_RED "Invalid email format!\n" COLOR_RESET);
+        } else if (isEmailTaken(newUser.email)) {
+            printColored(COLOR_RED "Email already registered! Please use another email.\n" COLOR_RESET);
+        } else {
+            break;
+        }
+    }
+
+    while (1) {
+        printf("Enter phone (11 digits): ");
+        scanf("%14s", newUser.phone);
+        clearInputBuffer();
+        if (!isPhoneValid(newUser.phone)) {
+            printColored(COLOR_RED "Phone number must be 11 digits!\n" COLOR_RESET);
+        } else if (isPhoneTaken(newUser.phone)) {
+            printColored(COLOR_RED "Phone number already registered!\n" COLOR_RESET);
+        } else {
+            break;
+        }
+    }
+
+    char password[PASSWORD_INPUT_LENGTH];
+    while (1) {
+        printf("Enter password: ");
+        hidePassword(password);
+        if (!isPasswordValid(password)) {
+            printColored(COLOR_RED "Password must be at least 8 characters long, contain a digit and a special character.\n" COLOR_RESET);
+        } else {
+            break;
+        }
+    }
+    if (!hashPassword(password, newUser.password)) {
+        printColored(COLOR_RED "Could not generate a password salt! Registration failed.\n" COLOR_RESET);
+        return;
+    }
+
+    newUser.role = role;
+    if (!addUser(&newUser)) {
+        printColored(COLOR_RED "Out of memory! Registration failed.\n" COLOR_RESET);
+        return;
+    }
+
+    printColored(COLOR_GREEN "Registration successful as %s!\n" COLOR_RESET, roleName(role));
+}
+
+void generateOTP(char *otp) {
+    const char digits[] = "0123456789";
+    srand(time(0));
+    for (int i = 0; i < 6; i++) {
+        otp[i] = digits[rand() % 10];
+    }
+    otp[6] = '\0';
+}
+
+void sendDemoOTP(const char *email, const char *otp) {
+    printColored(COLOR_BLUE "\nDemo Email Sent to: %s\n", email);
+    printf("Subject: Password Reset OTP\n");
+    printf("Message: Your OTP for password reset is: %s\n", otp);
+    printColored("(In a real system, this would be sent via email)\n\n" COLOR_RESET);
+}
+
+void forgotPassword() {
+    char username[50], email[100], otp[7], userOTP[7];
+    int found = 0;
+    User *user = NULL;
+    
+    printColored(COLOR_AQUA "\nForgot Password\n" COLOR_RESET);
+    printf("Enter your username: ");
+    scanf("%49s", username);
+    clearInputBuffer();
+    
+    printf("Enter your registered email: ");
+    scanf("%99s", email);
+    clearInputBuffer();
+    
+    // Find user with matching username and email
+    READ_LOCK(userLock);
+    int i = hashIndexFind(&usernameIndex, username);
+    if (i >= 0 && strcmp(userAt(i)->email, email) == 0) {
+        user = userAt(i);
+        found = 1;
+    }
+    RW_UNLOCK(userLock);
+    
+    if (!found) {
+        printColored(COLOR_RED "No account found with that username and email combination.\n" COLOR_RESET);
+        return;
+    }
+    
+    // Generate and send OTP
+    generateOTP(otp);
+    sendDemoOTP(email, otp);
+    
+    printf("Enter the OTP sent to your email: ");
+    scanf("%6s", userOTP);
+    clearInputBuffer();
+    
+    if (strcmp(otp, userOTP) != 0) {
+        printColored(COLOR_RED "Invalid OTP. Password reset failed.\n" COLOR_RESET);
+        return;
+    }
+    
+    // Get new password
+    char newPassword[50];
+    while (1) {
+        printf("Enter new password: ");
+        hidePassword(newPassword);
+        if (!isPasswordValid(newPassword)) {
+            printColored(COLOR_RED "Password must be at least 8 characters long, contain a digit and a special character.\n" COLOR_RESET);
+        } else {
+            break;
+        }
+    }
+    
+    // Confirm password
+    char confirmPassword[50];
+    printf("Confirm new password: ");
+    hidePassword(confirmPassword);
+    
+    if (strcmp(newPassword, confirmPassword) != 0) {
+        printColored(COLOR_RED "Passwords do not match. Password reset failed.\n" COLOR_RESET);
+        return;
+    }
+    
+    // Update password: hash outside the lock, then swap it in like checkLogin
+    char hashed[PASSWORD_HASH_LENGTH];
+    if (!hashPassword(newPassword, hashed)) {
+        printColored(COLOR_RED "Could not generate a password salt! Password not changed.\n" COLOR_RESET);
+        return;
+    }
+    WRITE_LOCK(userLock);
+    strcpy(user->password, hashed);
+    saveAllUsersToFile();
+    RW_UNLOCK(userLock);
+    printColored(COLOR_GREEN "Password reset successfully!\n" COLOR_RESET);
+}
+
+int loginUser(UserRole *role, char *username) {
+    char password[50] = {0};
+    int attempts = 0;
+    int choice;
+    
+    while (attempts < 3) {
+        printf("Enter username: ");
+        scanf("%49s", username);
+        clearInputBuffer();
+        
+        printf("Enter password: ");
+        hidePassword(password);
+        
+        if (userExists(username, password, role)) {
+            return 1;
+        }
+        
+        attempts++;
+        printColored(COLOR_RED "Login failed. Invalid username or password.\n" COLOR_RESET);
+        
+        if (attempts == 2) {
+            printf("Forgot password? Press '1' to reset password: ");
+            scanf("%d",&choice);
+            clearInputBuffer();
+            if (choice == 1) {
+                forgotPassword();
+            }
+        }
+    }
+    
+    printColored(COLOR_RED "Too many failed attempts. Please try again later.\n" COLOR_RESET);
+    return 0;
+}
+
+void viewCustomerOrderHistory() {
+    if (orderStore.count == 0) {
+        printColored(COLOR_YELLOW "\nNo orders have been placed yet.\n" COLOR_RESET);
+        return;
+    }
+
+    TextBuffer report = {0};
+    textAppendf(&report, COLOR_CORAL "\nCustomer Order History:\n" COLOR_RESET);
+    textAppendf(&report, "----------------------------------------------------------------------------------------\n");
+    textAppendf(&report, "Customer        Email                   Phone        Item            Quantity    Amount\n");
+    textAppendf(&report, "----------------------------------------------------------------------------------------\n");
+    
+    for (int i = 0; i < orderStore.count; i++) {
+        const Order *order = orderAt(i);
+        const User *user = order->userId >= 0 ? userAt(order->userId) : NULL;
+        
+        textAppendf(&report, "%-15s %-24s %-12s %-15s %-11d %.2ftk\n", 
+                    order->customerName, 
+                    user ? user->email : "N/A",
+                    user ? user->phone : "N/A",
+                    order->itemName, 
+                    order->quantity,
+                    order->totalAmount);
+    }
+    textAppendf(&report, "----------------------------------------------------------------------------------------\n");
+    textFlush(&report);
+    free(report.data);
+}
+
+// Grows a zero-filled array to hold at least needed elements; returns false when out of memory.
+bool growArray(void **array, int *capacity, int needed, size_t elementSize) {
+    if (needed <= *capacity) return true;
+    int newCapacity = *capacity ? *capacity : 16;
+    while (newCapacity < needed) newCapacity *= 2;
+    unsigned char *grown = realloc(*array, (size_t)newCapacity * elementSize);
+    if (grown == NULL) return false;
+    memset(grown + (size_t)*capacity * elementSize, 0, (size_t)(newCapacity - *capacity) * elementSize);
+    *array = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+// Local midnight of the day holding t, the midnight after it, and its date as yyyymmdd.
+int localDay(time_t t, time_t *start, time_t *end) {
+    struct tm local;
+    toLocalTime(t, &local);
+    local.tm_hour = local.tm_min = local.tm_sec = 0;
+    local.tm_isdst = -1;
+    *start = mktime(&local);
+    int date = (local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 + local.tm_mday;
+    local.tm_mday++;
+    local.tm_isdst = -1;
+    *end = mktime(&local);
+    return date;
+}
+
+// Position of the first day starting at or after start.
+int findSalesDay(time_t start) {
+    int low = 0, high = sales.dayCount;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (sales.days[mid].start < start) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Finds the day bucket holding t, adding it if needed. Orders arrive in time
+// order, so the common case is a hit on the last day used.
+SalesDay *salesDayFor(time_t t, int *hour) {
+    SalesDay *day = sales.lastDay >= 0 ? &sales.days[sales.lastDay] : NULL;
+    if (day == NULL || t < day->start || t >= day->end) {
+        time_t start, end;
+        int date = localDay(t, &start, &end);
+        int slot = findSalesDay(start);
+        if (slot == sales.dayCount || sales.days[slot].start != start) {
+            if (!growArray((void **)&sales.days, &sales.dayCapacity, sales.dayCount + 1, sizeof(SalesDay))) {
+                return NULL;
+            }
+            memmove(&sales.days[slot + 1], &sales.days[slot], (sales.dayCount - slot) * sizeof(SalesDay));
+            memset(&sales.days[slot], 0, sizeof(SalesDay));
+            sales.days[slot].date = date;
+            sales.days[slot].start = start;
+            sales.days[slot].end = end;
+            sales.dayCount++;
+        }
+        sales.lastDay = slot;
+        day = &sales.days[slot];
+    }
+
+    *hour = (int)((t - day->start) / 3600);
+    if (*hour > 23) *hour = 23; // the long day of a DST change
+    return day;
+}
+
+// The row is cached on the interned name, so recording a sale is O(1); the
+// row's name is compared by pointer in case the cache is stale.
+int salesItemFor(const Order *order) {
+    NameEntry *entry = nameEntryOf(order->itemName);
+    int cached = entry->salesIndex;
+    if (cached >= 0 && cached < sales.itemCount && sales.items[cached].name == order->itemName) return cached;
+    if (!growArray((void **)&sales.items, &sales.itemCapacity, sales.itemCount + 1, sizeof(ItemSales))) {
+        return -1;
+    }
+
+    ItemSales *item = &sales.items[sales.itemCount];
+    memset(item, 0, sizeof(*item));
+    item->name = order->itemName;
+    const MenuItem *menuItem = menuItemById(acquireMenu(), order->itemId);
+    strcpy(item->category, menuItem != NULL ? menuItem->category : "Other"); // item has left the menu
+    entry->salesIndex = sales.itemCount;
+    return sales.itemCount++;
+}
+
+bool growColumn(void **column, int capacity, size_t width) {
+    void *grown = realloc(*column, (size_t)capacity * width);
+    if (grown == NULL) return false;
+    *column = grown;
+    return true;
+}
+
+bool salesColumnsAppend(SalesColumns *columns, int orderIndex, int item) {
+    if (columns->count != orderIndex) return false; // an earlier row is missing
+    if (columns->count == columns->capacity) {
+        int newCapacity = columns->capacity ? columns->capacity * 2 : 1024;
+        if (!growColumn((void **)&columns->orderTime, newCapacity, sizeof(int64_t)) ||
+            !growColumn((void **)&columns->totalAmount, newCapacity, sizeof(float)) ||
+            !growColumn((void **)&columns->quantity, newCapacity, sizeof(int)) ||
+            !growColumn((void **)&columns->item, newCapacity, sizeof(int)) ||
+            !growColumn((void **)&columns->status, newCapacity, sizeof(uint8_t)) ||
+            !growColumn((void **)&columns->userId, newCapacity, sizeof(int32_t))) {
+            return false;
+        }
+        columns->capacity = newCapacity;
+    }
+
+    const Order *order = orderAt(orderIndex);
+    int row = columns->count++;
+    columns->orderTime[row] = order->orderTime;
+    columns->totalAmount[row] = order->totalAmount;
+    columns->quantity[row] = order->quantity;
+    columns->item[row] = item;
+    columns->status[row] = order->status;
+    columns->userId[row] = order->userId;
+    return true;
+}
+
+// Folds one new order into every aggregate. Callers hold the order table's
+// write lock, which also guards the analytics.
+void recordSale(int orderIndex) {
+    const Order *order = orderAt(orderIndex);
+
+    int hour;
+    SalesDay *day = salesDayFor(order->orderTime, &hour);
+    if (day != NULL) {
+        day->revenue[hour] += order->totalAmount;
+        day->orders[hour]++;
+    }
+
+    int item = salesItemFor(order);
+    if (item >= 0) {
+        sales.items[item].quantity += order->quantity;
+        sales.items[item].revenue += order->totalAmount;
+    }
+
+    if (order->userId < 0) {
+        sales.unknownCustomerSpend += order->totalAmount;
+    } else if (growArray((void **)&sales.customerSpend, &sales.customerCapacity, order->userId + 1, sizeof(double))) {
+        sales.customerSpend[order->userId] += order->totalAmount;
+    } else {
+        sales.incomplete = true;
+    }
+
+    if (!salesColumnsAppend(&sales.columns, orderIndex, item) || day == NULL || item < 0) {
+        sales.incomplete = true;
+    }
+}
+
+void rebuildSalesAnalytics() {
+    for (int i = 0; i < sales.itemCount; i++) {
+        nameEntryOf(sales.items[i].name)->salesIndex = -1;
+    }
+    sales.dayCount = 0;
+    sales.itemCount = 0;
+    sales.columns.count = 0;
+    sales.lastDay = -1;
+    sales.unknownCustomerSpend = 0;
+    sales.incomplete = false;
+    if (sales.customerSpend != NULL) {
+        memset(sales.customerSpend, 0, sales.customerCapacity * sizeof(double));
+    }
+    for (int i = 0; i < orderStore.count; i++) {
+        recordSale(i);
+    }
+}
+
+double sumAmountScalar(const float *amount, int count) {
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += amount[i];
+    return sum;
+}
+
+void countStatusScalar(const uint8_t *status, int count, int counts[STATUS_COUNT]) {
+    memset(counts, 0, STATUS_COUNT * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        if (status[i] < STATUS_COUNT) counts[status[i]]++;
+    }
+}
+
+int filterTimeScalar(const int64_t *orderTime, int count, int64_t from, int64_t to, int *rows) {
+    int matched = 0;
+    for (int i = 0; i < count; i++) {
+        if (orderTime[i] >= from && orderTime[i] < to) rows[matched++] = i;
+    }
+    return matched;
+}
+
+int filterCustomerScalar(const int32_t *userId, int count, int32_t customer, int *rows) {
+    int matched = 0;
+    for (int i = 0; i < count; i++) {
+        if (userId[i] == customer) rows[matched++] = i;
+    }
+    return matched;
+}
+
+#ifdef COLUMN_KERNELS_X86
+// Writes the row numbers of the set bits of mask, counting from base.
+static inline int emitRows(unsigned int mask, int base, int *rows) {
+    int matched = 0;
+    while (mask) {
+        rows[matched++] = base + __builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+    return matched;
+}
+
+__attribute__((target("sse2")))
+double sumAmountSse(const float *amount, int count) {
+    __m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 values = _mm_loadu_ps(amount + i);
+        low = _mm_add_pd(low, _mm_cvtps_pd(values));
+        high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(values, values)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(low, high));
+    return lanes[0] + lanes[1] + sumAmountScalar(amount + i, count - i);
+}
+
+__attribute__((target("sse2,popcnt")))
+void countStatusSse(const uint8_t *status, int count, int counts[STATUS_COUNT]) {
+    int i = count & ~15;
+    countStatusScalar(status + i, count - i, counts);
+    for (int s = 0; s < STATUS_COUNT; s++) {
+        __m128i wanted = _mm_set1_epi8((char)s);
+        int total = 0;
+        for (int j = 0; j < i; j += 16) {
+            __m128i values = _mm_loadu_si128((const __m128i *)(status + j));
+            total += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(values, wanted)));
+        }
+        counts[s] += total;
+    }
+}
+
+__attribute__((target("sse4.2")))
+int filterTimeSse(const int64_t *orderTime, int count, int64_t from, int64_t to, int *rows) {
+    __m128i low = _mm_set1_epi64x(from - 1), high = _mm_set1_epi64x(to);
+    int matched = 0, i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i values = _mm_loadu_si128((const __m128i *)(orderTime + i));
+        __m128i inside = _mm_and_si128(_mm_cmpgt_epi64(values, low), _mm_cmpgt_epi64(high, values));
+        matched += emitRows(_mm_movemask_pd(_mm_castsi128_pd(inside)), i, rows + matched);
+    }
+    int tail = filterTimeScalar(orderTime + i, count - i, from, to, rows + matched);
+    for (int j = 0; j < tail; j++) rows[matched + j] += i;
+    return matched + tail;
+}
+
+__attribute__((target("sse2")))
+int filterCustomerSse(const int32_t *userId, int count, int32_t customer, int *rows) {
+    __m128i wanted = _mm_set1_epi32(customer);
+    int matched = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i values = _mm_loadu_si128((const __m128i *)(userId + i));
+        matched += emitRows(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(values, wanted))), i, rows + matched);
+    }
+    int tail = filterCustomerScalar(userId + i, count - i, customer, rows + matched);
+    for (int j = 0; j < tail; j++) rows[matched + j] += i;
+    return matched + tail;
+}
+
+__attribute__((target("avx2")))
+double sumAmountAvx2(const float *amount, int count) {
+    __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 values = _mm256_loadu_ps(amount + i);
+        low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(values)));
+        high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(values, 1)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(low, high));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumAmountScalar(amount + i, count - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+void countStatusAvx2(const uint8_t *status, int count, int counts[STATUS_COUNT]) {
+    int i = count & ~31;
+    countStatusScalar(status + i, count - i, counts);
+    for (int s = 0; s < STATUS_COUNT; s++) {
+        __m256i wanted = _mm256_set1_epi8((char)s);
+        int total = 0;
+        for (int j = 0; j < i; j += 32) {
+            __m256i values = _mm256_loadu_si256((const __m256i *)(status + j));
+            total += __builtin_popcount((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(values, wanted)));
+        }
+        counts[s] += total;
+    }
+}
+
+__attribute__((target("avx2")))
+int filterTimeAvx2(const int64_t *orderTime, int count, int64_t from, int64_t to, int *rows) {
+    __m256i low = _mm256_set1_epi64x(from - 1), high = _mm256_set1_epi64x(to);
+    int matched = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i values = _mm256_loadu_si256((const __m256i *)(orderTime + i));
+        __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi64(values, low), _mm256_cmpgt_epi64(high, values));
+        matched += emitRows(_mm256_movemask_pd(_mm256_castsi256_pd(inside)), i, rows + matched);
+    }
+    int tail = filterTimeScalar(orderTime + i, count - i, from, to, rows + matched);
+    for (int j = 0; j < tail; j++) rows[matched + j] += i;
+    return matched + tail;
+}
+
+__attribute__((target("avx2")))
+int filterCustomerAvx2(const int32_t *userId, int count, int32_t customer, int *rows) {
+    __m256i wanted = _mm256_set1_epi32(customer);
+    int matched = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i values = _mm256_loadu_si256((const __m256i *)(userId + i));
+        matched += emitRows(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(values, wanted))), i, rows + matched);
+    }
+    int tail = filterCustomerScalar(userId + i, count - i, customer, rows + matched);
+    for (int j = 0; j < tail; j++) rows[matched + j] += i;
+    return matched + tail;
+}
+#endif
+
+const ColumnKernels scalarKernels = {
+    "scalar", sumAmountScalar, countStatusScalar, filterTimeScalar, filterCustomerScalar
+};
+#ifdef COLUMN_KERNELS_X86
+const ColumnKernels sseKernels = {
+    "sse4.2", sumAmountSse, countStatusSse, filterTimeSse, filterCustomerSse
+};
+const ColumnKernels avx2Kernels = {
+    "avx2", sumAmountAvx2, countStatusAvx2, filterTimeAvx2, filterCustomerAvx2
+};
+#endif
+const ColumnKernels *columnKernels = &scalarKernels;
+
+// Picks the widest kernel set this CPU runs.
+void selectColumnKernels() {
+#ifdef COLUMN_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        columnKernels = &avx2Kernels;
+    } else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+        columnKernels = &sseKernels;
+    }
+#endif
+}
+
+int compareItemRevenue(const void *a, const void *b) {
+    double left = sales.items[*(const int *)a].revenue;
+    double right = sales.items[*(const int *)b].revenue;
+    return (left < right) - (left > right);
+}
+
+int compareItemCategory(const void *a, const void *b) {
+    return strcmp(sales.items[*(const int *)a].category, sales.items[*(const int *)b].category);
+}
+
+void viewSalesReports() {
+    READ_LOCK(userLock);
+    READ_LOCK(orderLock);
+    if (sales.columns.count == 0) {
+        RW_UNLOCK(orderLock);
+        RW_UNLOCK(userLock);
+        printColored(COLOR_YELLOW "\nNo orders have been placed yet.\n" COLOR_RESET);
+        return;
+    }
+
+    TextBuffer report = {0};
+    time_t now = time(NULL);
+    textAppendf(&report, COLOR_CORAL "\nSales Reports:\n" COLOR_RESET);
+    if (sales.incomplete) {
+        textAppendf(&report, COLOR_RED "Ran out of memory while counting; figures are incomplete.\n" COLOR_RESET);
+    }
+
+    // Whole-table figures come straight from the columns
+    const SalesColumns *columns = &sales.columns;
+    int statusCounts[STATUS_COUNT];
+    columnKernels->countStatus(columns->status, columns->count, statusCounts);
+    textAppendf(&report, "All time: %d orders, %.2ftk (", columns->count,
+                columnKernels->sumAmount(columns->totalAmount, columns->count));
+    for (int i = 0; i < STATUS_COUNT; i++) {
+        textAppendf(&report, "%s%d %s", i ? ", " : "", statusCounts[i], statusNames[i]);
+    }
+    textAppendf(&report, ")\n");
+
+    int *rows = malloc(columns->count * sizeof(int));
+    if (rows != NULL) {
+        int recentOrders = columnKernels->filterTime(columns->orderTime, columns->count,
+                                                     now - SALES_RECENT_MINUTES * 60, INT64_MAX, rows);
+        double recentRevenue = 0;
+        for (int i = 0; i < recentOrders; i++) recentRevenue += columns->totalAmount[rows[i]];
+        textAppendf(&report, "Last %d minutes: %d orders, %.2ftk\n", SALES_RECENT_MINUTES, recentOrders, recentRevenue);
+        free(rows);
+    }
+
+    time_t todayStart, todayEnd;
+    localDay(now, &todayStart, &todayEnd);
+    int todaySlot = findSalesDay(todayStart);
+    const SalesDay *today = todaySlot < sales.dayCount && sales.days[todaySlot].start == todayStart ?
+                            &sales.days[todaySlot] : NULL;
+    textAppendf(&report, "\nToday by hour:\n");
+    textAppendf(&report, "Hour    Orders    Revenue\n");
+    for (int h = 0; today != NULL && h < 24; h++) {
+        if (today->orders[h] == 0) continue;
+        textAppendf(&report, "%02d:00   %-9d %.2ftk\n", h, today->orders[h], today->revenue[h]);
+    }
+
+    textAppendf(&report, "\nLast %d days:\n", SALES_DAYS_SHOWN);
+    textAppendf(&report, "Date          Orders    Revenue\n");
+    int firstDay = sales.dayCount > SALES_DAYS_SHOWN ? sales.dayCount - SALES_DAYS_SHOWN : 0;
+    for (int d = firstDay; d < sales.dayCount; d++) {
+        const SalesDay *day = &sales.days[d];
+        double revenue = 0;
+        int orders = 0;
+        for (int h = 0; h < 24; h++) {
+            revenue += day->revenue[h];
+            orders += day->orders[h];
+        }
+        if (orders == 0) continue;
+        textAppendf(&report, "%04d-%02d-%02d    %-9d %.2ftk\n",
+                    day->date / 10000, day->date / 100 % 100, day->date % 100, orders, revenue);
+    }
+
+    int *ranked = malloc(sales.itemCount * sizeof(int));
+    if (ranked != NULL) {
+        for (int i = 0; i < sales.itemCount; i++) ranked[i] = i;
+        qsort(ranked, sales.itemCount, sizeof(int), compareItemRevenue);
+        textAppendf(&report, "\nTop %d items:\n", SALES_TOP_N);
+        textAppendf(&report, "Item               Quantity    Revenue\n");
+        for (int i = 0; i < sales.itemCount && i < SALES_TOP_N; i++) {
+            const ItemSales *item = &sales.items[ranked[i]];
+            textAppendf(&report, "%-18s %-11lld %.2ftk\n", item->name, item->quantity, item->revenue);
+        }
+
+        // Categories come and go with the menu, so group the items by name
+        qsort(ranked, sales.itemCount, sizeof(int), compareItemCategory);
+        textAppendf(&report, "\nBy category:\n");
+        for (int i = 0; i < sales.itemCount; ) {
+            const char *category = sales.items[ranked[i]].category;
+            double revenue = 0;
+            long long quantity = 0;
+            for (; i < sales.itemCount && strcmp(sales.items[ranked[i]].category, category) == 0; i++) {
+                revenue += sales.items[ranked[i]].revenue;
+                quantity += sales.items[ranked[i]].quantity;
+            }
+            if (quantity > 0) {
+                textAppendf(&report, "%-12s %-11lld %.2ftk\n", category, quantity, revenue);
+            }
+        }
+        free(ranked);
+    }
+
+    // Top spenders by partial insertion into a fixed-size leaderboard
+    int top[SALES_TOP_N];
+    int topCount = 0;
+    int customers = sales.customerCapacity < userStore.count ? sales.customerCapacity : userStore.count;
+    for (int u = 0; u < customers; u++) {
+        double spend = sales.customerSpend[u];
+        if (spend <= 0) continue;
+        if (topCount == SALES_TOP_N && spend <= sales.customerSpend[top[topCount - 1]]) continue;
+        int j = topCount < SALES_TOP_N ? topCount++ : topCount - 1;
+        while (j > 0 && sales.customerSpend[top[j - 1]] < spend) {
+            top[j] = top[j - 1];
+            j--;
+        }
+        top[j] = u;
+    }
+    textAppendf(&report, "\nTop %d customers:\n", SALES_TOP_N);
+    for (int i = 0; i < topCount; i++) {
+        textAppendf(&report, "%-15s %.2ftk\n", userAt(top[i])->username, sales.customerSpend[top[i]]);
+    }
+    if (sales.unknownCustomerSpend > 0) {
+        textAppendf(&report, "%-15s %.2ftk\n", "(unregistered)", sales.unknownCustomerSpend);
+    }
+    RW_UNLOCK(orderLock);
+    RW_UNLOCK(userLock);
+
+    textFlush(&report);
+    free(report.data);
+}
+
+void adminMenu(char *currentUsername) {
+    int choice;
+    while (1) {
+        renderText(COLOR_CORAL "\nAdmin Menu:\n" COLOR_RESET
+                   "1. Add Menu Item\n2. Delete Menu Item\n"
+                   "3. View Menu\n4. View Orders\n5. View Customer Order History\n6. Sales Reports\n"
+                   "7. Search Menu\n8. Logout\n");
+        choice = getNumericInput(1, 8, "Enter your choice: ");
+
+        switch (choice) {
+            case 1: addMenuItem(); break;
+            case 2: deleteMenuItem(); break;
+            case 3: viewMenu(); break;
+            case 4: viewOrders(ROLE_ADMIN, currentUsername); break;
+            case 5: viewCustomerOrderHistory(); break;
+            case 6: viewSalesReports(); break;
+            case 7: searchMenuItems(); break;
+            case 8: return;
+            default: printColored(COLOR_RED "Invalid choice\n" COLOR_RESET);
+        }
+    }
+}
+
+void customerMenu(char *currentUsername) {
+    int choice;
+    while (1) {
+        printPaymentNotices(currentUsername);
+        renderText(COLOR_CORAL "\nCustomer Menu:\n" COLOR_RESET
+                   "1. View Menu\n2. Place Order\n3. View Orders\n4. Search Menu\n5. Logout\n");
+        choice = getNumericInput(1, 5, "Enter your choice: ");
+
+        switch (choice) {
+            case 1: viewMenu(); break;
+            case 2: placeOrder(currentUsername); break;
+            case 3: viewOrders(ROLE_CUSTOMER, currentUsername); break;
+            case 4: searchMenuItems(); break;
+            case 5: return;
+            default: printColored(COLOR_RED "Invalid choice\n" COLOR_RESET);
+        }
+    }
+}
+
+void chefMenu(char *currentUsername) {
+    int choice;
+    while (1) {
+        renderText(COLOR_CORAL "\nChef Menu:\n" COLOR_RESET
+                   "1. View Orders\n2. Mark Next Ticket Ready\n3. Deliver Next Ready Order\n"
+                   "4. Update Order Status\n5. Logout\n");
+        choice = getNumericInput(1, 5, "Enter your choice: ");
+
+        int orderIndex;
+        switch (choice) {
+            case 1: viewOrders(ROLE_CHEF, currentUsername); break;
+            case 2:
+                orderIndex = completeNextTicket();
+                if (orderIndex < 0) {
+                    printColored(COLOR_YELLOW "No tickets waiting.\n" COLOR_RESET);
+                } else {
+                    printColored(COLOR_GREEN "Order %d (%d x %s for %s) is Ready!\n" COLOR_RESET, orderIndex + 1,
+                           orderAt(orderIndex)->quantity, orderAt(orderIndex)->itemName, orderAt(orderIndex)->customerName);
+                }
+                break;
+            case 3:
+                orderIndex = deliverNextOrder();
+                if (orderIndex < 0) {
+                    printColored(COLOR_YELLOW "No orders ready for delivery.\n" COLOR_RESET);
+                } else {
+                    printColored(COLOR_GREEN "Order %d delivered to %s.\n" COLOR_RESET, orderIndex + 1, orderAt(orderIndex)->customerName);
+                }
+                break;
+            case 4: updateOrderStatus(); break;
+            case 5: return;
+            default: printColored(COLOR_RED "Invalid choice\n" COLOR_RESET);
+        }
+    }
+}
+
+void addMenuItem() {
+    printf("Enter item name: ");
+    char name[50];
+    scanf("%49[^\n]", name);
+    clearInputBuffer();
+    
+    const MenuSnapshot *menu = acquireMenu();
+    TextBuffer screen = {0};
+    textAppendf(&screen, "Select category:\n");
+    for (int i = 0; i < menu->categoryCount; i++) {
+        textAppendf(&screen, "%d. %s\n", i+1, menu->categories[i].name);
+    }
+    textAppendf(&screen, "%d. New category\n", menu->categoryCount + 1);
+    textFlush(&screen);
+    free(screen.data);
+    int catChoice = getNumericInput(1, menu->categoryCount + 1, "Enter category number: ");
+    
+    char category[20] = "";
+    if (catChoice <= menu->categoryCount) {
+        strcpy(category, menu->categories[catChoice-1].name);
+    } else {
+        printf("Enter category name: ");
+        scanf("%19[^\n]", category);
+        clearInputBuffer();
+        if (category[0] == '\0') {
+            printColored(COLOR_RED "Category name cannot be empty!\n" COLOR_RESET);
+            return;
+        }
+        int existing = findCategory(menu, category, NULL);
+        if (existing >= 0) strcpy(category, menu->categories[existing].name);
+    }
+    
+    printf("Enter item price: ");
+    float price;
+    scanf("%f", &price);
+    clearInputBuffer();
+    
+    MenuItem item;
+    memset(&item, 0, sizeof(item));
+    item.name = internName(name);
+    strcpy(item.category, category);
+    item.price = price;
+    
+    if (item.name == NULL || addToMenu(&item) == MENU_NO_ITEM) {
+        printColored(COLOR_RED "Item not added.\n" COLOR_RESET);
+        return;
+    }
+    printColored(COLOR_GREEN "Menu item added successfully!\n" COLOR_RESET);
+}
+
+void deleteMenuItem() {
+    const MenuSnapshot *shown = acquireMenu();
+    showMenu(shown);
+    if (shown->liveCount == 0) return;
+    
+    int itemNum = getNumericInput(1, shown->slotCount, "Enter item number to delete: ");
+    MenuItemId id = menuIdAt(shown, itemNum - 1);
+    if (id == MENU_NO_ITEM) {
+        printColored(COLOR_RED "No such item!\n" COLOR_RESET);
+    } else if (!removeFromMenu(id)) {
+        printColored(COLOR_RED "Menu item not deleted.\n" COLOR_RESET);
+    } else {
+        printColored(COLOR_GREEN "Menu item deleted successfully!\n" COLOR_RESET);
+    }
+}
+
+void viewMenu() {
+    showMenu(acquireMenu());
+}
+
+void showMenu(const MenuSnapshot *menu) {
+    TextBuffer screen = {0};
+    textAppendf(&screen, COLOR_CORAL "\nMenu Items:\n" COLOR_RESET);
+    textAppendf(&screen, "--------------------------------------------------\n");
+    textAppendf(&screen, "No.  Item Name          Price\n");
+    textAppendf(&screen, "--------------------------------------------------\n");
+    // Numbers are slots, so they stay the same when other items are deleted
+    for (int c = 0; c < menu->categoryCount; c++) {
+        const MenuCategory *category = &menu->categories[c];
+        textAppendf(&screen, COLOR_AQUA "%s\n" COLOR_RESET, category->name);
+        for (int i = 0; i < category->count; i++) {
+            const MenuItem *item = &menuSlotAt(menu, category->slots[i])->item;
+            textAppendf(&screen, "%-4d %-18s %.2ftk\n", category->slots[i] + 1, item->name, item->price);
+        }
+    }
+    textAppendf(&screen, "--------------------------------------------------\n");
+    textFlush(&screen);
+    free(screen.data);
+}
+
+void searchMenuItems() {
+    char prefix[50] = "";
+    printf("Search items: ");
+    scanf("%49[^\n]", prefix);
+    clearInputBuffer();
+    
+    const MenuSnapshot *menu = acquireMenu();
+    MenuItemId found[MENU_SEARCH_LIMIT];
+    int count = searchMenu(menu, prefix, found, MENU_SEARCH_LIMIT);
+    if (count == 0) {
+        printColored(COLOR_YELLOW "No items match \"%s\".\n" COLOR_RESET, prefix);
+        return;
+    }
+    
+    TextBuffer screen = {0};
+    textAppendf(&screen, "--------------------------------------------------\n");
+    textAppendf(&screen, "No.  Category     Item Name          Price\n");
+    textAppendf(&screen, "--------------------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        const MenuItem *item = menuItemById(menu, found[i]);
+        textAppendf(&screen, "%-4u %-12s %-18s %.2ftk\n", (found[i] & MENU_SLOT_MASK) + 1, item->category, item->name, item->price);
+    }
+    if (count == MENU_SEARCH_LIMIT) {
+        textAppendf(&screen, "Showing the first %d matches.\n", MENU_SEARCH_LIMIT);
+    }
+    textAppendf(&screen, "--------------------------------------------------\n");
+    textFlush(&screen);
+    free(screen.data);
+}
+
+// Places one ticket: builds every cart line in a single pass and persists them
+// with one log write and one fsync. Returns the index of the first line, or -1.
+int createOrders(const char *username, const MenuSnapshot *menu, const CartLine *cart, int lineCount, float *total) {
+    uint64_t start = metricStart();
+    int userId = hashIndexFind(&usernameIndex, username);
+    time_t now = time(NULL);
+    *total = 0;
+
+    reservePersist(lineCount);
+    WRITE_LOCK(orderLock);
+    int firstIndex = orderStore.count;
+    for (int i = 0; i < lineCount; i++) {
+        Order *order = storeAppend(&orderStore);
+        if (order == NULL) {
+            orderStore.count = firstIndex;
+            RW_UNLOCK(orderLock);
+            releasePersist(lineCount);
+            metricStop(METRIC_PLACE_ORDER, start);
+            return -1;
+        }
+        const MenuItem *item = menuItemById(menu, cart[i].item); // callers check the ids
+        strcpy(order->customerName, username);
+        order->userId = userId;
+        order->itemId = cart[i].item;
+        order->itemName = item->name;
+        order->quantity = cart[i].quantity;
+        order->status = STATUS_PROCESSING;
+        order->payment = PAYMENT_UNPAID;
+        order->queued = QUEUED_BIT(STATUS_PROCESSING); // pushed once the locks are released
+        order->sequence = nextOrderSequence + i;
+        order->totalAmount = cart[i].quantity * item->price;
+        order->orderTime = now;
+        *total += order->totalAmount;
+        linkCustomerOrder(firstIndex + i);
+        recordSale(firstIndex + i);
+        if (!timeIndexAppend(firstIndex + i)) {
+            printColored(COLOR_RED "Out of memory! Order %d is missing from the time index.\n" COLOR_RESET, firstIndex + i + 1);
+        }
+    }
+    nextOrderSequence += lineCount;
+    
+    MUTEX_LOCK(orderLogLock);
+    appendOrderLog(LOG_ORDER, firstIndex, lineCount);
+    MUTEX_UNLOCK(orderLogLock);
+    RW_UNLOCK(orderLock);
+
+    for (int i = 0; i < lineCount; i++) {
+        if (!kitchenPush(&processingQueue, firstIndex + i)) {
+            printColored(COLOR_RED "Out of memory! Order %d is missing from the kitchen queue.\n" COLOR_RESET, firstIndex + i + 1);
+        }
+    }
+    metricStop(METRIC_PLACE_ORDER, start);
+    return firstIndex;
+}
+
+void placeOrder(char *currentUsername) {
+    // Item numbers refer to the snapshot shown, even if the menu is edited meanwhile
+    const MenuSnapshot *menu = acquireMenu();
+    showMenu(menu);
+    if (menu->liveCount == 0) {
+        printColored(COLOR_RED "No items available to order.\n" COLOR_RESET);
+        return;
+    }
+    
+    CartLine cart[MAX_CART_LINES];
+    int lineCount = 0;
+    while (lineCount < MAX_CART_LINES) {
+        int itemNum = getNumericInput(0, menu->slotCount, "Enter item number to add (0 to checkout): ");
+        if (itemNum == 0) break;
+        
+        cart[lineCount].item = menuIdAt(menu, itemNum - 1);
+        if (cart[lineCount].item == MENU_NO_ITEM) {
+            printColored(COLOR_RED "No such item!\n" COLOR_RESET);
+            continue;
+        }
+        cart[lineCount].quantity = getNumericInput(1, 100, "Enter quantity: ");
+        printColored(COLOR_GREEN "Added %d x %s to cart.\n" COLOR_RESET, cart[lineCount].quantity,
+               menuItemById(menu, cart[lineCount].item)->name);
+        lineCount++;
+    }
+    if (lineCount == MAX_CART_LINES) {
+        printColored(COLOR_YELLOW "Cart is full, proceeding to checkout.\n" COLOR_RESET);
+    }
+    if (lineCount == 0) {
+        printColored(COLOR_YELLOW "Cart is empty. No order placed.\n" COLOR_RESET);
+        return;
+    }
+    
+    float total;
+    int firstIndex = createOrders(currentUsername, menu, cart, lineCount, &total);
+    if (firstIndex < 0) {
+        printColored(COLOR_RED "Out of memory! Order not placed.\n" COLOR_RESET);
+        return;
+    }
+    
+    TextBuffer screen = {0};
+    textAppendf(&screen, COLOR_CORAL "\nOrder Summary:\n" COLOR_RESET);
+    for (int i = 0; i < lineCount; i++) {
+        const Order *order = orderAt(firstIndex + i);
+        textAppendf(&screen, "%-18s x%-4d %.2ftk\n", order->itemName, order->quantity, order->totalAmount);
+    }
+    textAppendf(&screen, "Total: %.2ftk\n", total);
+    textFlush(&screen);
+    free(screen.data);
+    
+    processPayment(firstIndex, lineCount, total);
+}
+
+int compareOrderTime(const void *a, const void *b) {
+    int left = *(const int *)a, right = *(const int *)b;
+    time_t leftTime = orderAt(left)->orderTime, rightTime = orderAt(right)->orderTime;
+    if (leftTime != rightTime) return leftTime < rightTime ? -1 : 1;
+    return (left > right) - (left < right);
+}
+
+// Position of the first entry whose order is newer than t (upper) or at least as
+// new as t (lower).
+int timeIndexBound(time_t t, bool upper) {
+    int low = 0, high = orderTimeIndex.count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        time_t midTime = orderAt(orderTimeIndex.orders[mid])->orderTime;
+        if (midTime < t || (upper && midTime == t)) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+int findOrdersFrom(time_t from) {
+    return timeIndexBound(from, false);
+}
+
+// New orders almost always carry the latest time and land at the end; an order
+// from a clock that stepped back is inserted in place.
+bool timeIndexAppend(int orderIndex) {
+    TimeIndex *index = &orderTimeIndex;
+    if (!growArray((void **)&index->orders, &index->capacity, index->count + 1, sizeof(int))) return false;
+
+    int position = index->count;
+    if (position > 0 && orderAt(index->orders[position - 1])->orderTime > orderAt(orderIndex)->orderTime) {
+        position = timeIndexBound(orderAt(orderIndex)->orderTime, true);
+        memmove(&index->orders[position + 1], &index->orders[position], (index->count - position) * sizeof(int));
+    }
+    index->orders[position] = orderIndex;
+    index->count++;
+    return true;
+}
+
+void rebuildTimeIndex() {
+    orderTimeIndex.count = 0;
+    if (!growArray((void **)&orderTimeIndex.orders, &orderTimeIndex.capacity, orderStore.count, sizeof(int))) {
+        printColored(COLOR_RED "Out of memory while indexing orders by time!\n" COLOR_RESET);
+        return;
+    }
+
+    bool sorted = true;
+    for (int i = 0; i < orderStore.count; i++) {
+        orderTimeIndex.orders[i] = i;
+        if (i > 0 && orderAt(i)->orderTime < orderAt(i - 1)->orderTime) sorted = false;
+    }
+    orderTimeIndex.count = orderStore.count;
+    if (!sorted) {
+        qsort(orderTimeIndex.orders, orderTimeIndex.count, sizeof(int), compareOrderTime);
+    }
+}
+
+void appendOrderRow(TextBuffer *screen, int i) {
+    char timeStr[9];
+    formatClockTime(orderAt(i)->orderTime, timeStr);
+    
+    textAppendf(screen, "%-4d %-15s %-15s %-11d %-11s %.2ftk    %-9s %s\n", 
+                i+1,
+                orderAt(i)->customerName, 
+                orderAt(i)->itemName, 
+                orderAt(i)->quantity, 
+                statusNames[orderAt(i)->status],
+                orderAt(i)->totalAmount,
+                timeStr,
+                paymentStateNames[orderAt(i)->payment]);
+}
+
+// Prints the time index entries in [begin, end) as one page of the order table.
+void viewOrderRange(int begin, int end, int page, int pages) {
+    TextBuffer screen = {0};
+    textAppendf(&screen, COLOR_CORAL "\nCurrent Orders (page %d of %d):\n" COLOR_RESET, page, pages);
+    textAppendf(&screen, "--------------------------------------------------------------------------------\n");
+    textAppendf(&screen, "No.  Customer        Item            Quantity    Status      Amount    Time      Payment\n");
+    textAppendf(&screen, "--------------------------------------------------------------------------------\n");
+    for (int i = begin; i < end; i++) {
+        appendOrderRow(&screen, orderTimeIndex.orders[i]);
+    }
+    textAppendf(&screen, "--------------------------------------------------------------------------------\n");
+    textFlush(&screen);
+    free(screen.data);
+}
+
+// Lets staff pick a time range and page through it oldest first.
+void browseOrders() {
+    TextBuffer screen = {0};
+    textAppendf(&screen, "\nShow:\n1. Last %d Minutes\n2. Today\n3. All Orders\n", RECENT_ORDER_MINUTES);
+    textFlush(&screen);
+    free(screen.data);
+    int range = getNumericInput(1, 3, "Enter your choice: ");
+
+    time_t now = time(NULL), dayStart, dayEnd;
+    int begin = 0;
+    if (range == 1) {
+        begin = findOrdersFrom(now - RECENT_ORDER_MINUTES * 60);
+    } else if (range == 2) {
+        localDay(now, &dayStart, &dayEnd);
+        begin = findOrdersFrom(dayStart);
+    }
+    int total = orderTimeIndex.count - begin;
+    if (total == 0) {
+        printColored(COLOR_YELLOW "\nNo orders in this range.\n" COLOR_RESET);
+        return;
+    }
+
+    int pages = (total + ORDER_PAGE_SIZE - 1) / ORDER_PAGE_SIZE;
+    int page = 1;
+    while (page != 0) {
+        int first = begin + (page - 1) * ORDER_PAGE_SIZE;
+        int last = first + ORDER_PAGE_SIZE < orderTimeIndex.count ? first + ORDER_PAGE_SIZE : orderTimeIndex.count;
+        viewOrderRange(first, last, page, pages);
+        if (pages == 1) return;
+        page = getNumericInput(0, pages, "Enter page number (0 to go back): ");
+    }
+}
+
+void viewOrders(UserRole currentUserRole, char *currentUsername) {
+    if (currentUserRole & ROLE_STAFF) {
+        browseOrders();
+        return;
+    }
+
+    TextBuffer screen = {0};
+    textAppendf(&screen, COLOR_CORAL "\nCurrent Orders:\n" COLOR_RESET);
+    textAppendf(&screen, "--------------------------------------------------------------------------------\n");
+    textAppendf(&screen, "No.  Customer        Item            Quantity    Status      Amount    Time      Payment\n");
+    textAppendf(&screen, "--------------------------------------------------------------------------------\n");
+    
+    // Customers only walk their own list
+    int userId = hashIndexFind(&usernameIndex, currentUsername);
+    int next = userId >= 0 ? userAt(userId)->firstOrder : 0;
+    for (; next != 0; next = orderAt(next - 1)->nextByCustomer) {
+        appendOrderRow(&screen, next - 1);
+    }
+    textAppendf(&screen, "--------------------------------------------------------------------------------\n");
+    textFlush(&screen);
+    free(screen.data);
+}
+
+bool setOrderStatus(int orderIndex, OrderStatus status) {
+    // The table lock only pins the chunk directory; status writes and their log
+    // records are serialized by the log mutex so they reach the log in order.
+    uint64_t start = metricStart();
+    reservePersist(1);
+    // Manual corrections re-enter the matching queue unless the order already
+    // waits there; entries left behind in the other queue are skipped when popped
+    // because their status no longer matches.
+    KitchenQueue *queue = kitchenQueueFor(status);
+    bool enqueue = false;
+    READ_LOCK(orderLock);
+    bool found = orderIndex >= 0 && orderIndex < orderStore.count;
+    if (found) {
+        MUTEX_LOCK(orderLogLock);
+        Order *order = orderAt(orderIndex);
+        order->status = status;
+        if (orderIndex < sales.columns.count) sales.columns.status[orderIndex] = status;
+        appendOrderLog(LOG_STATUS, orderIndex, 1);
+        enqueue = queue != NULL && !(order->queued & QUEUED_BIT(status));
+        if (enqueue) order->queued |= QUEUED_BIT(status);
+        MUTEX_UNLOCK(orderLogLock);
+    }
+    RW_UNLOCK(orderLock);
+    if (!found) releasePersist(1);
+    if (enqueue) kitchenPush(queue, orderIndex);
+    metricStop(METRIC_SET_STATUS, start);
+    return found;
+}
+
+bool kitchenQueueInit(KitchenQueue *queue, size_t capacity) {
+    queue->cells = malloc(capacity * sizeof(KitchenCell));
+    if (queue->cells == NULL) return false;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+    }
+    queue->mask = capacity - 1;
+    atomic_init(&queue->enqueuePos, 0);
+    atomic_init(&queue->dequeuePos, 0);
+    atomic_init(&queue->spilled, 0);
+    return true;
+}
+
+bool kitchenRingPush(KitchenQueue *queue, int orderIndex) {
+    size_t pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+    while (1) {
+        KitchenCell *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->orderIndex = orderIndex;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+        }
+    }
+}
+
+bool kitchenRingPop(KitchenQueue *queue, int *orderIndex) {
+    size_t pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+    while (1) {
+        KitchenCell *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *orderIndex = cell->orderIndex;
+                atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+        }
+    }
+}
+
+// Appends to the spill list; fails only when it cannot grow.
+bool kitchenSpill(KitchenQueue *queue, int orderIndex) {
+    MUTEX_LOCK(kitchenSpillLock);
+    if (queue->spillHead > 0 && queue->spillHead + queue->spillCount == queue->spillCapacity) {
+        memmove(queue->spill, queue->spill + queue->spillHead, queue->spillCount * sizeof(int));
+        queue->spillHead = 0;
+    }
+    bool ok = growArray((void **)&queue->spill, &queue->spillCapacity,
+                        queue->spillHead + queue->spillCount + 1, sizeof(int));
+    if (ok) {
+        queue->spill[queue->spillHead + queue->spillCount++] = orderIndex;
+        atomic_store_explicit(&queue->spilled, queue->spillCount, memory_order_release);
+    }
+    MUTEX_UNLOCK(kitchenSpillLock);
+    return ok;
+}
+
+// Uses the ring only while nothing has spilled, so a ticket pushed after
+// another one's push returned is always served after it. Ordering is only
+// approximate between pushes that overlap: a producer that read spilled as 0
+// just before another one spilled may still land in a slot freed meanwhile,
+// ahead of the spilled ticket.
+bool kitchenPush(KitchenQueue *queue, int orderIndex) {
+    if (queue->cells == NULL) return false;
+    if (atomic_load_explicit(&queue->spilled, memory_order_acquire) == 0 &&
+        kitchenRingPush(queue, orderIndex)) return true;
+    return kitchenSpill(queue, orderIndex);
+}
+
+// Pops from the ring and refills the slots it frees from the spill list; once
+// the ring is empty the oldest spilled ticket is handed out directly.
+bool kitchenPop(KitchenQueue *queue, int *orderIndex) {
+    if (queue->cells == NULL) return false;
+    bool popped = kitchenRingPop(queue, orderIndex);
+    if (atomic_load_explicit(&queue->spilled, memory_order_acquire) == 0) return popped;
+
+    MUTEX_LOCK(kitchenSpillLock);
+    if (!popped && queue->spillCount > 0) {
+        *orderIndex = queue->spill[queue->spillHead++];
+        queue->spillCount--;
+        popped = true;
+    }
+    while (queue->spillCount > 0 && kitchenRingPush(queue, queue->spill[queue->spillHead])) {
+        queue->spillHead++;
+        queue->spillCount--;
+    }
+    if (queue->spillCount == 0) queue->spillHead = 0;
+    atomic_store_explicit(&queue->spilled, queue->spillCount, memory_order_release);
+    MUTEX_UNLOCK(kitchenSpillLock);
+    return popped;
+}
+
+KitchenQueue *kitchenQueueFor(OrderStatus status) {
+    if (status == STATUS_PROCESSING) return &processingQueue;
+    if (status == STATUS_READY) return &readyQueue;
+    return NULL;
+}
+
+// Queues every open ticket of the loaded history, oldest first, skipping those
+// already queued by an earlier rebuild.
+void rebuildKitchenQueues() {
+    if (processingQueue.cells == NULL && !kitchenQueueInit(&processingQueue, KITCHEN_QUEUE_CAPACITY)) return;
+    if (readyQueue.cells == NULL && !kitchenQueueInit(&readyQueue, KITCHEN_QUEUE_CAPACITY)) return;
+
+    int missing = 0;
+    for (int i = 0; i < orderStore.count; i++) {
+        Order *order = orderAt(i);
+        KitchenQueue *queue = kitchenQueueFor(order->status);
+        if (queue != NULL && !(order->queued & QUEUED_BIT(order->status))) {
+            order->queued |= QUEUED_BIT(order->status);
+            missing += !kitchenPush(queue, i);
+        }
+    }
+    if (missing > 0) {
+        printColored(COLOR_RED "Out of memory! %d open orders are missing from the kitchen queues.\n" COLOR_RESET, missing);
+    }
+}
+
+// Moves an order just popped from the queue of from to the next status, only
+// if nobody else already did, and queues it for to when that has a queue.
+bool advanceOrderStatus(int orderIndex, OrderStatus from, OrderStatus to) {
+    uint64_t start = metricStart();
+    KitchenQueue *queue = kitchenQueueFor(to);
+    bool enqueue = false;
+    reservePersist(1);
+    READ_LOCK(orderLock);
+    MUTEX_LOCK(orderLogLock);
+    Order *order = orderAt(orderIndex);
+    order->queued &= ~QUEUED_BIT(from);
+    bool moved = order->status == from;
+    if (moved) {
+        order->status = to;
+        if (orderIndex < sales.columns.count) sales.columns.status[orderIndex] = to;
+        appendOrderLog(LOG_STATUS, orderIndex, 1);
+        enqueue = queue != NULL && !(order->queued & QUEUED_BIT(to));
+        if (enqueue) order->queued |= QUEUED_BIT(to);
+    }
+    MUTEX_UNLOCK(orderLogLock);
+    RW_UNLOCK(orderLock);
+    if (!moved) releasePersist(1);
+    if (enqueue) kitchenPush(queue, orderIndex);
+    metricStop(METRIC_SET_STATUS, start);
+    return moved;
+}
+
+// Marks the oldest cooking ticket Ready; returns its index, or -1 if none wait.
+int completeNextTicket() {
+    int orderIndex;
+    while (kitchenPop(&processingQueue, &orderIndex)) {
+        if (advanceOrderStatus(orderIndex, STATUS_PROCESSING, STATUS_READY)) {
+            return orderIndex;
+        }
+    }
+    return -1;
+}
+
+// Marks the oldest Ready order Delivered; returns its index, or -1 if none wait.
+int deliverNextOrder() {
+    int orderIndex;
+    while (kitchenPop(&readyQueue, &orderIndex)) {
+        if (advanceOrderStatus(orderIndex, STATUS_READY, STATUS_DELIVERED)) {
+            return orderIndex;
+        }
+    }
+    return -1;
+}
+
+void updateOrderStatus() {
+    if (orderStore.count == 0) {
+        printColored(COLOR_YELLOW "\nNo orders have been placed yet.\n" COLOR_RESET);
+        return;
+    }
+    // Show the newest page; older orders can still be picked by number
+    int pages = (orderTimeIndex.count + ORDER_PAGE_SIZE - 1) / ORDER_PAGE_SIZE;
+    viewOrderRange((pages - 1) * ORDER_PAGE_SIZE, orderTimeIndex.count, pages, pages);
     
-    int itemNum = getNumericInput(1, menuCount, "Enter item number to order: ");
-    
-    int quantity = getNumericInput(1, 100, "Enter quantity: ");
-    
-    strcpy(orders[orderCount].customerName, currentUsername);
-    strcpy(orders[orderCount].itemName, menu[itemNum-1].name);
-    orders[orderCount].quantity = quantity;
-    strcpy(orders[orderCount].status, "Processing");
+    int orderNum = getNumericInput(1, orderStore.count, "Enter order number to update status: ");
     
-    float total = quantity * menu[itemNum-1].price;
-    orders[orderCount].totalAmount = total;
-    orders[orderCount].orderTime = time(NULL);
+    printf("Current status: %s\n", statusNames[orderAt(orderNum-1)->status]);
+    printf("Enter new status (Processing/Ready/Delivered): ");
+    char input[20];
+    scanf("%19s", input);
+    clearInputBuffer();
     
-    saveOrderToFile(orders[orderCount]);
-    orderCount++;
+    OrderStatus status;
+    if (!parseOrderStatus(input, &status) || !setOrderStatus(orderNum-1, status)) {
+        printColored(COLOR_RED "Invalid status! Status remains unchanged.\n" COLOR_RESET);
+        return;
+    }
     
-    processPayment(total);
+    printColored(COLOR_GREEN "Order status updated!\n" COLOR_RESET);
+}
+
+void sleepMilliseconds(int milliseconds) {
+#ifdef _WIN32
+    Sleep(milliseconds);
+#else
+    struct timespec delay = { milliseconds / 1000, (milliseconds % 1000) * 1000000L };
+    while (nanosleep(&delay, &delay) != 0) {}
+#endif
+}
+
+// splitmix64 over a shared counter, so workers draw without a lock
+uint64_t mockGatewayRandom() {
+    uint64_t z = atomic_fetch_add(&mockGatewaySeed, 0x9E3779B97F4A7C15ull) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Stands in for a real gateway: waits out the configured latency, then
+// declines the configured share of payments.
+bool mockAuthorize(PaymentMethod method, float amount) {
+    (void)method;
+    int latency = mockGateway.latencyMs;
+    if (mockGateway.jitterMs > 0) {
+        latency += (int)(mockGatewayRandom() % (2 * mockGateway.jitterMs + 1)) - mockGateway.jitterMs;
+    }
+    if (latency > 0) sleepMilliseconds(latency);
+    return amount > 0 && (int)(mockGatewayRandom() % 100) >= mockGateway.failurePercent;
+}
+
+const PaymentProvider mockProvider = { "mock", mockAuthorize };
+const PaymentProvider *paymentProvider = &mockProvider;
+
+int readPaymentSetting(const char *name, int value, int min, int max) {
+    const char *text = getenv(name);
+    if (text == NULL) return value;
+    long parsed = strtol(text, NULL, 10);
+    if (parsed >= min && parsed <= max) return (int)parsed;
+    fprintf(stderr, "%s must be %d-%d; using %d.\n", name, min, max, value);
+    return value;
+}
+
+void initPayments() {
+    mockGateway.latencyMs = readPaymentSetting("PAYMENT_LATENCY_MS", mockGateway.latencyMs, 0, 60000);
+    mockGateway.jitterMs = readPaymentSetting("PAYMENT_JITTER_MS", mockGateway.jitterMs, 0, mockGateway.latencyMs);
+    mockGateway.failurePercent = readPaymentSetting("PAYMENT_FAILURE_PERCENT", mockGateway.failurePercent, 0, 100);
+    paymentQueue.workerCount = readPaymentSetting("PAYMENT_WORKERS", PAYMENT_DEFAULT_WORKERS, 1, PAYMENT_MAX_WORKERS);
+    atomic_store(&mockGatewaySeed, (uint64_t)time(NULL));
+}
+
+// Records the provider's answer against every order the payment covers and
+// logs it, then posts a notice for the terminal.
+void settlePayment(Payment *payment, PaymentState state) {
+    reservePersist(payment->orderCount);
+    READ_LOCK(orderLock);
+    MUTEX_LOCK(orderLogLock);
+    for (int i = 0; i < payment->orderCount; i++) {
+        orderAt(payment->firstOrder + i)->payment = state;
+    }
+    appendOrderLog(LOG_PAYMENT, payment->firstOrder, payment->orderCount);
+    MUTEX_UNLOCK(orderLogLock);
+    RW_UNLOCK(orderLock);
+
+    payment->state = state;
+    double now = monotonicSeconds();
+    MUTEX_LOCK(paymentLock);
+    if (payment->method != CASH) {
+        if (state == PAYMENT_PAID) paymentQueue.paid++;
+        else paymentQueue.declined++;
+        if (paymentQueue.firstSubmitted == 0 || payment->submitted < paymentQueue.firstSubmitted) {
+            paymentQueue.firstSubmitted = payment->submitted;
+        }
+        paymentQueue.lastSettled = now;
+        recordLatency(&paymentQueue.latency, now - payment->submitted);
+    }
+    paymentQueue.notices[(paymentQueue.noticeHead + paymentQueue.noticeCount) % PAYMENT_NOTICE_SLOTS] = *payment;
+    if (paymentQueue.noticeCount < PAYMENT_NOTICE_SLOTS) {
+        paymentQueue.noticeCount++;
+    } else {
+        paymentQueue.noticeHead = (paymentQueue.noticeHead + 1) % PAYMENT_NOTICE_SLOTS;
+    }
+    MUTEX_UNLOCK(paymentLock);
+}
+
+void authorizePayment(Payment *payment) {
+    uint64_t start = metricStart();
+    bool approved = paymentProvider->authorize(payment->method, payment->amount);
+    metricStop(METRIC_PAYMENT, start);
+    settlePayment(payment, approved ? PAYMENT_PAID : PAYMENT_DECLINED);
+}
+
+// Marks the orders Pending and queues their payment, returning at once; the
+// result is recorded against the orders when the provider answers. Cash needs
+// no provider and is settled on the spot. Without worker threads (Windows)
+// the provider is called inline.
+bool submitPayment(int firstOrder, int orderCount, PaymentMethod method, const char **error) {
+    Payment payment = { firstOrder, orderCount, method, PAYMENT_PENDING, 0, monotonicSeconds() };
+    if (method < CASH || method >= PAYMENT_METHOD_COUNT) {
+        *error = "unknown payment method";
+        return false;
+    }
+
+    // The log mutex serializes payment state changes, as it does status changes
+    READ_LOCK(orderLock);
+    MUTEX_LOCK(orderLogLock);
+    *error = NULL;
+    if (orderCount <= 0 || firstOrder < 0 || firstOrder > orderStore.count - orderCount) {
+        *error = "no such order";
+    }
+    for (int i = 0; *error == NULL && i < orderCount; i++) {
+        const Order *order = orderAt(firstOrder + i);
+        if (order->payment == PAYMENT_PAID || order->payment == PAYMENT_PENDING) {
+            *error = order->payment == PAYMENT_PAID ? "order already paid" : "payment already pending";
+        }
+        payment.amount += order->totalAmount;
+    }
+    if (*error == NULL) {
+        for (int i = 0; i < orderCount; i++) orderAt(firstOrder + i)->payment = PAYMENT_PENDING;
+    }
+    MUTEX_UNLOCK(orderLogLock);
+    RW_UNLOCK(orderLock);
+    if (*error != NULL) return false;
+
+    if (method == CASH) {
+        settlePayment(&payment, PAYMENT_PAID);
+        return true;
+    }
+    if (!paymentQueue.running) {
+        authorizePayment(&payment);
+        return true;
+    }
+
+    MUTEX_LOCK(paymentLock);
+    bool queued = paymentQueue.count < PAYMENT_QUEUE_CAPACITY;
+    if (queued) {
+        paymentQueue.pending[(paymentQueue.head + paymentQueue.count) % PAYMENT_QUEUE_CAPACITY] = payment;
+        paymentQueue.count++;
+        COND_BROADCAST(paymentWork);
+    }
+    MUTEX_UNLOCK(paymentLock);
+    if (!queued) {
+        // Nothing was logged for Pending, so the orders simply revert
+        READ_LOCK(orderLock);
+        MUTEX_LOCK(orderLogLock);
+        for (int i = 0; i < orderCount; i++) orderAt(firstOrder + i)->payment = PAYMENT_UNPAID;
+        MUTEX_UNLOCK(orderLogLock);
+        RW_UNLOCK(orderLock);
+        *error = "payment queue full";
+    }
+    return queued;
+}
+
+#ifndef _WIN32
+// Waits for the next payment; returns false once stopping with none left.
+bool takePayment(Payment *payment) {
+    MUTEX_LOCK(paymentLock);
+    while (paymentQueue.count == 0 && !paymentQueue.stopping) {
+        COND_WAIT(paymentWork, paymentLock);
+    }
+    bool taken = paymentQueue.count > 0;
+    if (taken) {
+        *payment = paymentQueue.pending[paymentQueue.head];
+        paymentQueue.head = (paymentQueue.head + 1) % PAYMENT_QUEUE_CAPACITY;
+        paymentQueue.count--;
+        paymentQueue.inFlight++;
+    }
+    MUTEX_UNLOCK(paymentLock);
+    return taken;
+}
+
+void *paymentWorker(void *arg) {
+    (void)arg;
+    Payment payment;
+    while (takePayment(&payment)) {
+        authorizePayment(&payment);
+        MUTEX_LOCK(paymentLock);
+        paymentQueue.inFlight--;
+        if (paymentQueue.count == 0 && paymentQueue.inFlight == 0) COND_BROADCAST(paymentIdle);
+        MUTEX_UNLOCK(paymentLock);
+    }
+    return NULL;
+}
+#endif
+
+bool startPayments() {
+#ifdef _WIN32
+    return false;
+#else
+    paymentQueue.pending = malloc(PAYMENT_QUEUE_CAPACITY * sizeof(Payment));
+    if (paymentQueue.pending == NULL) {
+        printColored(COLOR_YELLOW "Out of memory for the payment queue; payments will wait for the provider.\n" COLOR_RESET);
+        return false;
+    }
+    int started = 0;
+    while (started < paymentQueue.workerCount &&
+           pthread_create(&paymentThreads[started], NULL, paymentWorker, NULL) == 0) {
+        started++;
+    }
+    paymentQueue.workerCount = started;
+    if (started == 0) {
+        free(paymentQueue.pending);
+        printColored(COLOR_YELLOW "Could not start payment workers; payments will wait for the provider.\n" COLOR_RESET);
+        return false;
+    }
+    paymentQueue.running = true;
+    return true;
+#endif
+}
+
+// Lets every queued payment settle, then stops the workers. Called at exit,
+// before the writer stops, so the results are saved.
+void stopPayments() {
+    if (!paymentQueue.running) return;
+#ifndef _WIN32
+    MUTEX_LOCK(paymentLock);
+    while (paymentQueue.count > 0 || paymentQueue.inFlight > 0) {
+        COND_WAIT(paymentIdle, paymentLock);
+    }
+    paymentQueue.stopping = true;
+    COND_BROADCAST(paymentWork);
+    MUTEX_UNLOCK(paymentLock);
+    for (int i = 0; i < paymentQueue.workerCount; i++) {
+        pthread_join(paymentThreads[i], NULL);
+    }
+#endif
+    paymentQueue.running = false;
+    free(paymentQueue.pending);
+}
+
+// Shows the results that came back for this customer's payments since the
+// last call. Notices for other customers stay until they are overwritten.
+void printPaymentNotices(const char *username) {
+    TextBuffer screen = {0};
+    READ_LOCK(orderLock);
+    MUTEX_LOCK(paymentLock);
+    int kept = 0;
+    for (int i = 0; i < paymentQueue.noticeCount; i++) {
+        Payment *notice = &paymentQueue.notices[(paymentQueue.noticeHead + i) % PAYMENT_NOTICE_SLOTS];
+        if (strcmp(orderAt(notice->firstOrder)->customerName, username) != 0) {
+            paymentQueue.notices[(paymentQueue.noticeHead + kept++) % PAYMENT_NOTICE_SLOTS] = *notice;
+            continue;
+        }
+        textAppendf(&screen, "%sPayment of %.2ftk via %s for order %d: %s\n" COLOR_RESET,
+                    notice->state == PAYMENT_PAID ? COLOR_GREEN : COLOR_RED, notice->amount,
+                    paymentMethodNames[notice->method], notice->firstOrder + 1, paymentStateNames[notice->state]);
+    }
+    paymentQueue.noticeCount = kept;
+    MUTEX_UNLOCK(paymentLock);
+    RW_UNLOCK(orderLock);
+    textFlush(&screen);
+    free(screen.data);
+}
+
+// Reads a field of digits of an allowed length, hidden when it is a secret
+void readPaymentDigits(const char *prompt, const char *label, int minLength, int maxLength, bool hidden) {
+    char input[PASSWORD_INPUT_LENGTH];
+    while (1) {
+        printf("%s", prompt);
+        if (hidden) {
+            hidePassword(input);
+        } else {
+            scanf("%49s", input);
+            clearInputBuffer();
+        }
+        int length = (int)strlen(input);
+        bool digits = length > 0;
+        for (int i = 0; i < length; i++) digits = digits && isdigit((unsigned char)input[i]);
+        if (digits && length >= minLength && length <= maxLength) return;
+        if (minLength == maxLength) {
+            printColored(COLOR_RED "Invalid %s! Must be %d digits.\n" COLOR_RESET, label, minLength);
+        } else {
+            printColored(COLOR_RED "Invalid %s! Must be %d-%d digits.\n" COLOR_RESET, label, minLength, maxLength);
+        }
+    }
+}
+
+// Collects the payment details for a ticket and hands the payment to the
+// provider; the customer can carry on while it is authorised.
+void processPayment(int firstIndex, int lineCount, float total) {
+    TextBuffer screen = {0};
+    textAppendf(&screen, COLOR_CORAL "\nPayment Options:\n" COLOR_RESET);
+    for (int method = CASH; method < PAYMENT_METHOD_COUNT; method++) {
+        textAppendf(&screen, "%d. %s\n", method + 1, paymentMethodNames[method]);
+    }
+    textFlush(&screen);
+    free(screen.data);
+    PaymentMethod method = getNumericInput(1, PAYMENT_METHOD_COUNT, "Select payment method: ") - 1;
+    const char *name = paymentMethodNames[method];
+    char prompt[64];
+
+    if (method >= BKASH && method <= NAGAD) {
+        printf("\nProcessing payment via %s (%.2f)\n", name, total);
+        readPaymentDigits("Enter mobile number (11 digits): ", "mobile number", 11, 11, false);
+        readPaymentDigits("Enter security code (3 digits): ", "security code", 3, 3, true);
+        snprintf(prompt, sizeof(prompt), "Enter %s PIN (4-6 digits): ", name);
+        readPaymentDigits(prompt, "PIN", 4, 6, true);
+    } else if (method == VISA || method == MASTERCARD) {
+        printf("\nProcessing payment via %s (%.2f)\n", name, total);
+        snprintf(prompt, sizeof(prompt), "Enter %s card number (16 digits): ", name);
+        readPaymentDigits(prompt, "card number", 16, 16, false);
+        readPaymentDigits("Enter verification code (3-4 digits): ", "verification code", 3, 4, true);
+        readPaymentDigits("Enter card PIN (4 digits): ", "PIN", 4, 4, true);
+    }
+
+    const char *error;
+    if (!submitPayment(firstIndex, lineCount, method, &error)) {
+        printColored(COLOR_RED "Payment failed: %s. The order is placed but unpaid.\n" COLOR_RESET, error);
+    } else if (method == CASH) {
+        printColored(COLOR_GREEN "Paid %.2f in Cash. Thank you!\n" COLOR_RESET, total);
+    } else {
+        printColored(COLOR_GREEN "Payment of %.2f via %s sent for authorisation. You can keep ordering.\n" COLOR_RESET, total, name);
+    }
+}
+
+double monotonicSeconds() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+uint64_t monotonicNanos() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart * 1000000000ull +
+                      counter.QuadPart % frequency.QuadPart * 1000000000ull / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+void dumpMetricsAtExit() {
+    dumpMetrics();
+}
+
+void initMetrics() {
+    metricsPath = getenv("METRICS_FILE");
+    if (metricsPath == NULL || metricsPath[0] == '\0') return;
+    metricsEnabled = true;
+    metrics.started = monotonicNanos();
+    atexit(dumpMetricsAtExit);
+}
+
+// With metrics off a timer costs one predictable branch and no clock read
+uint64_t metricStart() {
+    return metricsEnabled ? monotonicNanos() : 0;
+}
+
+int histogramBucket(uint64_t nanos) {
+    if (nanos < METRIC_SUB_BUCKETS) return (int)nanos;
+    if (nanos >> METRIC_MAX_BITS) nanos = (1ull << METRIC_MAX_BITS) - 1;
+#if defined(__GNUC__) || defined(__clang__)
+    int exponent = 63 - __builtin_clzll(nanos);
+#else
+    int exponent = METRIC_SUB_BITS;
+    while (nanos >> (exponent + 1)) exponent++;
+#endif
+    return (exponent - METRIC_SUB_BITS + 1) * METRIC_SUB_BUCKETS +
+           (int)((nanos >> (exponent - METRIC_SUB_BITS)) & (METRIC_SUB_BUCKETS - 1));
+}
+
+// Smallest value that falls in bucket; the bucket is width values wide
+uint64_t histogramBucketStart(int bucket, uint64_t *width) {
+    if (bucket < METRIC_SUB_BUCKETS) {
+        *width = 1;
+        return bucket;
+    }
+    int shift = bucket / METRIC_SUB_BUCKETS - 1;
+    *width = 1ull << shift;
+    return (uint64_t)(METRIC_SUB_BUCKETS + bucket % METRIC_SUB_BUCKETS) << shift;
+}
+
+void metricStop(Metric metric, uint64_t start) {
+    if (start == 0) return;
+    uint64_t nanos = monotonicNanos() - start;
+    Histogram *histogram = &metrics.operations[metric];
+    atomic_fetch_add_explicit(&histogram->buckets[histogramBucket(nanos)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->totalNanos, nanos, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&histogram->maxNanos, memory_order_relaxed);
+    while (nanos > max && !atomic_compare_exchange_weak_explicit(&histogram->maxNanos, &max, nanos,
+                                                                  memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+// bytes counts toward bytes read for IO_READ and bytes written for IO_WRITE
+void countIo(IoCall call, uint64_t bytes) {
+    if (!metricsEnabled) return;
+    atomic_fetch_add_explicit(&metrics.ioCalls[call], 1, memory_order_relaxed);
+    if (call == IO_READ) atomic_fetch_add_explicit(&metrics.bytesRead, bytes, memory_order_relaxed);
+    if (call == IO_WRITE) atomic_fetch_add_explicit(&metrics.bytesWritten, bytes, memory_order_relaxed);
+}
+
+// Upper end of the bucket holding the given fraction of samples, capped at
+// the largest sample, so a percentile is never understated
+uint64_t histogramPercentile(const uint64_t *buckets, uint64_t count, uint64_t max, double fraction) {
+    uint64_t rank = (uint64_t)(fraction * count + 0.5), seen = 0;
+    if (rank == 0) rank = 1;
+    for (int i = 0; i < METRIC_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t width, value = histogramBucketStart(i, &width) + width - 1;
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+// Writes every histogram and I/O counter to METRICS_FILE as JSON. Bucket
+// lists keep only non-empty buckets, as [first ns, count] pairs. The file is
+// replaced whole, so a reader never sees half a dump.
+bool dumpMetrics() {
+    if (!metricsEnabled) return false;
+    uint64_t buckets[METRIC_BUCKETS];
+    TextBuffer json = {0};
+    bool ok = textAppendf(&json, "{\n  \"uptime_seconds\": %.3f,\n  \"operations\": {",
+                          (monotonicNanos() - metrics.started) / 1e9);
+    for (int metric = 0; ok && metric < METRIC_COUNT; metric++) {
+        Histogram *histogram = &metrics.operations[metric];
+        uint64_t count = 0;
+        for (int i = 0; i < METRIC_BUCKETS; i++) {
+            buckets[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+            count += buckets[i];
+        }
+        uint64_t total = atomic_load_explicit(&histogram->totalNanos, memory_order_relaxed);
+        uint64_t max = atomic_load_explicit(&histogram->maxNanos, memory_order_relaxed);
+        ok = textAppendf(&json, "%s\n    \"%s\": {\"count\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, "
+                         "\"p90_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f, \"buckets\": [",
+                         metric ? "," : "", metricNames[metric], (unsigned long long)count,
+                         count ? total / 1e3 / count : 0.0,
+                         count ? histogramPercentile(buckets, count, max, 0.50) / 1e3 : 0.0,
+                         count ? histogramPercentile(buckets, count, max, 0.90) / 1e3 : 0.0,
+                         count ? histogramPercentile(buckets, count, max, 0.99) / 1e3 : 0.0,
+                         count ? histogramPercentile(buckets, count, max, 0.999) / 1e3 : 0.0,
+                         max / 1e3);
+        bool first = true;
+        for (int i = 0; ok && i < METRIC_BUCKETS; i++) {
+            if (buckets[i] == 0) continue;
+            uint64_t width;
+            ok = textAppendf(&json, "%s[%llu, %llu]", first ? "" : ", ",
+                             (unsigned long long)histogramBucketStart(i, &width), (unsigned long long)buckets[i]);
+            first = false;
+        }
+        ok = ok && textAppendf(&json, "]}");
+    }
+    ok = ok && textAppendf(&json, "\n  },\n  \"io\": {");
+    for (int call = 0; ok && call < IO_CALL_COUNT; call++) {
+        ok = textAppendf(&json, "\"%s\": %llu, ", ioCallNames[call],
+                         (unsigned long long)atomic_load_explicit(&metrics.ioCalls[call], memory_order_relaxed));
+    }
+    ok = ok && textAppendf(&json, "\"bytes_read\": %llu, \"bytes_written\": %llu}\n}\n",
+                           (unsigned long long)atomic_load(&metrics.bytesRead),
+                           (unsigned long long)atomic_load(&metrics.bytesWritten));
+
+    char tempPath[256];
+    FILE *file = ok ? openTempFile(metricsPath, tempPath, sizeof(tempPath), "wb") : NULL;
+    if (file != NULL) {
+        ok = fwrite(json.data, 1, json.length, file) == json.length;
+        if (ok) {
+            ok = commitTempFile(file, tempPath, metricsPath);
+        } else {
+            fclose(file);
+            remove(tempPath);
+        }
+    }
+    ok = ok && file != NULL;
+    free(json.data);
+    if (!ok) fprintf(stderr, "Error writing metrics to %s\n", metricsPath);
+    return ok;
+}
+
+int linearFindUser(size_t keyOffset, const char *key) {
+    for (int i = 0; i < userStore.count; i++) {
+        if (strcmp((const char *)userAt(i) + keyOffset, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Compares the hash indexes against the linear scans they replaced, using an
+// in-memory table of synthetic users (nothing is written to users.txt).
+int benchmarkUserIndex(int userTotal) {
+    const int linearLookups = 200;
+    const int hashLookups = 1000000;
+    char key[50];
+    volatile int sink = 0;
+
+    printf("Generating %d users...\n", userTotal);
+    userStore.count = 0;
+    hashIndexClear(&usernameIndex);
+    hashIndexClear(&emailIndex);
+    hashIndexClear(&phoneIndex);
+    for (int i = 0; i < userTotal; i++) {
+        User *user = storeAppend(&userStore);
+        if (user == NULL) {
+            printColored(COLOR_RED "Out of memory after %d users!\n" COLOR_RESET, i);
+            return 1;
+        }
+        snprintf(user->username, sizeof(user->username), "user%d", i);
+        snprintf(user->email, sizeof(user->email), "user%d@example.com", i);
+        snprintf(user->phone, sizeof(user->phone), "017%08d", i);
+        strcpy(user->password, "secret#123");
+        user->role = ROLE_CUSTOMER;
+        if (!indexUser(i)) {
+            printColored(COLOR_RED "Out of memory after %d users!\n" COLOR_RESET, i);
+            return 1;
+        }
+    }
+
+    // Probe keys spread across the table, so the linear scan averages n/2
+    double start = monotonicSeconds();
+    for (int i = 0; i < linearLookups; i++) {
+        snprintf(key, sizeof(key), "user%d", (int)((long long)i * 7919 % userTotal));
+        sink += linearFindUser(offsetof(User, username), key);
+    }
+    double linearNs = (monotonicSeconds() - start) * 1e9 / linearLookups;
+
+    start = monotonicSeconds();
+    for (int i = 0; i < hashLookups; i++) {
+        snprintf(key, sizeof(key), "user%d", (int)((long long)i * 7919 % userTotal));
+        sink += hashIndexFind(&usernameIndex, key);
+    }
+    double hashNs = (monotonicSeconds() - start) * 1e9 / hashLookups;
+
+    printf("%-24s %14s\n", "Username lookup", "ns/lookup");
+    printf("%-24s %14.1f\n", "linear scan", linearNs);
+    printf("%-24s %14.1f\n", "hash index", hashNs);
+    printf("Speedup: %.0fx\n", linearNs / hashNs);
+    return sink == 0x7fffffff;
+}
+
+// The fscanf loader that loadOrdersFromFile() replaced, kept as a baseline.
+void loadOrdersWithScanf() {
+    FILE *file = fopen(ORDER_DB_FILE, "r");
+    if (file == NULL) {
+        return;
+    }
+
+    Order order;
+    char itemName[50];
+    char status[20];
+    OrderStatus parsedStatus;
+    orderStore.count = 0;
+    int first = fgetc(file);
+    if (first == '#') {
+        while (first != '\n' && first != EOF) first = fgetc(file);
+    } else if (first != EOF) {
+        ungetc(first, file);
+    }
+    while (fscanf(file, "%49[^,],%49[^,],%d,%19[^,],%f,%ld\n", 
+           order.customerName,
+           itemName,
+           &order.quantity,
+           status,
+           &order.totalAmount,
+           &order.orderTime) == 6) {
+        Order *slot = storeAppend(&orderStore);
+        if (slot == NULL) break;
+        order.status = parseOrderStatus(status, &parsedStatus) ? parsedStatus : STATUS_PROCESSING;
+        order.payment = PAYMENT_UNPAID;
+        order.itemName = internName(itemName);
+        if (order.itemName == NULL) break;
+        setOrderItem(&order, order.itemName);
+        order.userId = hashIndexFind(&usernameIndex, order.customerName);
+        order.nextByCustomer = 0;
+        *slot = order;
+    }
+    fclose(file);
+}
+
+double orderTableChecksum() {
+    double sum = 0;
+    for (int i = 0; i < orderStore.count; i++) {
+        const Order *order = orderAt(i);
+        sum += order->totalAmount + order->quantity + (double)order->orderTime + order->customerName[0];
+    }
+    return sum;
+}
+
+// Times a cold-ish load of a synthetic order history through both loaders.
+int benchmarkLoad(int orderTotal) {
+    const char *path = "bench_orders.txt";
+    const char *names[] = {"Plain Rice", "Biryani", "Doner", "Kacchi Biryani", "Adana Kebab"};
+
+    printf("Writing %d orders to %s...\n", orderTotal, path);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printColored(COLOR_RED "Cannot create %s\n" COLOR_RESET, path);
+        return 1;
+    }
+    for (int i = 0; i < orderTotal; i++) {
+        int quantity = 1 + i % 7;
+        fprintf(file, "customer%d,%s,%d,%s,%.2f,%ld\n", i % 50000, names[i % 5], quantity,
+                statusNames[i % STATUS_COUNT], quantity * 120.5, 1700000000L + i);
+    }
+    fclose(file);
+
+    const char *savedPath = ORDER_DB_FILE;
+    ORDER_DB_FILE = path;
+
+    double start = monotonicSeconds();
+    loadOrdersWithScanf();
+    double scanfSeconds = monotonicSeconds() - start;
+    int scanfCount = orderStore.count;
+    double scanfChecksum = orderTableChecksum();
+
+    start = monotonicSeconds();
+    loadOrdersFromFile();
+    double mappedSeconds = monotonicSeconds() - start;
+    double mappedChecksum = orderTableChecksum();
+
+    ORDER_DB_FILE = savedPath;
+    remove(path);
+
+    printf("%-24s %10s %12s\n", "Order loader", "rows", "ms");
+    printf("%-24s %10d %12.1f\n", "fscanf", scanfCount, scanfSeconds * 1e3);
+    printf("%-24s %10d %12.1f\n", "mmap tokenizer", orderStore.count, mappedSeconds * 1e3);
+    printf("Speedup: %.1fx\n", scanfSeconds / mappedSeconds);
+    if (scanfCount != orderStore.count || scanfChecksum != mappedChecksum) {
+        printColored(COLOR_RED "Loaders disagree!\n" COLOR_RESET);
+        return 1;
+    }
+    return 0;
 }
 
-void viewOrders(char *currentUserRole, char *currentUsername) {
-    printf(COLOR_CORAL "\nCurrent Orders:\n" COLOR_RESET);
-    printf("--------------------------------------------------------------------\n");
-    printf("No.  Customer        Item            Quantity    Status      Amount    Time\n");
-    printf("--------------------------------------------------------------------\n");
-    
-    for (int i = 0; i < orderCount; i++) {
-        if (strcmp(currentUserRole, "Admin") == 0 || 
-            strcmp(currentUserRole, "Chef") == 0 ||
-            strcmp(orders[i].customerName, currentUsername) == 0) {
-            
-            char timeStr[20];
-            struct tm *timeinfo = localtime(&orders[i].orderTime);
-            strftime(timeStr, sizeof(timeStr), "%H:%M:%S", timeinfo);
-            
-            printf("%-4d %-15s %-15s %-11d %-11s %.2ftk    %s\n", 
-                   i+1,
-                   orders[i].customerName, 
-                   orders[i].itemName, 
-                   orders[i].quantity, 
-                   orders[i].status,
-                   orders[i].totalAmount,
-                   timeStr);
+// Times each kernel set against the row-at-a-time loops over the order table and
+// checks they agree.
+int benchmarkColumns(int rowTotal) {
+    const char *customers[] = {"alice", "bob", "carol", "dave"};
+    printf("Building %d synthetic orders...\n", rowTotal);
+    installMenu(defaultMenu());
+    const MenuSnapshot *menu = acquireMenu();
+    userStore.count = 0;
+    hashIndexClear(&usernameIndex);
+    for (int i = 0; i < 4; i++) {
+        User *user = storeAppend(&userStore);
+        strcpy(user->username, customers[i]);
+        hashIndexInsert(&usernameIndex, i);
+    }
+    orderStore.count = 0;
+    for (int i = 0; i < rowTotal; i++) {
+        Order *order = storeAppend(&orderStore);
+        if (order == NULL) {
+            printColored(COLOR_RED "Out of memory!\n" COLOR_RESET);
+            return 1;
+        }
+        order->itemId = menuIdAt(menu, i % menu->slotCount);
+        const MenuItem *item = menuItemById(menu, order->itemId);
+        strcpy(order->customerName, customers[i % 4]);
+        order->itemName = item->name;
+        order->userId = i % 5 == 4 ? -1 : i % 4;
+        order->quantity = 1 + i % 7;
+        order->status = i % 11 % STATUS_COUNT;
+        order->totalAmount = order->quantity * item->price + (i % 100) * 0.25f;
+        order->orderTime = 1700000000L + i * 3L;
+    }
+    rebuildSalesAnalytics();
+    if (sales.columns.count != rowTotal) {
+        printColored(COLOR_RED "Out of memory!\n" COLOR_RESET);
+        return 1;
+    }
+
+    int64_t from = 1700000000L + rowTotal, to = 1700000000L + 2L * rowTotal;
+    int *expectedRows = malloc(rowTotal * sizeof(int));
+    int *rows = malloc(rowTotal * sizeof(int));
+    if (expectedRows == NULL || rows == NULL) {
+        printColored(COLOR_RED "Out of memory!\n" COLOR_RESET);
+        return 1;
+    }
+
+    // Reference: the row-at-a-time loops the order screens use
+    double start = monotonicSeconds();
+    double expectedSum = 0;
+    int expectedCounts[STATUS_COUNT] = {0};
+    for (int i = 0; i < orderStore.count; i++) {
+        expectedSum += orderAt(i)->totalAmount;
+        expectedCounts[orderAt(i)->status]++;
+    }
+    int expectedTime = 0;
+    for (int i = 0; i < orderStore.count; i++) {
+        if (orderAt(i)->orderTime >= from && orderAt(i)->orderTime < to) expectedTime++;
+    }
+    int expectedCustomer = 0;
+    for (int i = 0; i < orderStore.count; i++) {
+        if (orderAt(i)->userId == 1) expectedRows[expectedCustomer++] = i;
+    }
+    double rowSeconds = monotonicSeconds() - start;
+
+    const ColumnKernels *sets[3] = {&scalarKernels};
+    int setCount = 1;
+#ifdef COLUMN_KERNELS_X86
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) sets[setCount++] = &sseKernels;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) sets[setCount++] = &avx2Kernels;
+#endif
+
+    printf("%-14s %12s %12s %12s %12s %12s\n", "Kernels", "sum ms", "status ms", "time ms", "customer ms", "total ms");
+    printf("%-14s %12s %12s %12s %12s %12.2f\n", "row loops", "", "", "", "", rowSeconds * 1e3);
+    const SalesColumns *columns = &sales.columns;
+    bool agree = true;
+    for (int k = 0; k < setCount; k++) {
+        const ColumnKernels *kernels = sets[k];
+        double best[4] = {1e9, 1e9, 1e9, 1e9};
+        for (int round = 0; round < COLUMN_BENCH_ROUNDS; round++) {
+            int counts[STATUS_COUNT];
+            double t0 = monotonicSeconds();
+            double sum = kernels->sumAmount(columns->totalAmount, columns->count);
+            double t1 = monotonicSeconds();
+            kernels->countStatus(columns->status, columns->count, counts);
+            double t2 = monotonicSeconds();
+            int timeMatched = kernels->filterTime(columns->orderTime, columns->count, from, to, rows);
+            double t3 = monotonicSeconds();
+            int customerMatched = kernels->filterCustomer(columns->userId, columns->count, 1, rows);
+            double t4 = monotonicSeconds();
+
+            double laps[4] = {t1 - t0, t2 - t1, t3 - t2, t4 - t3};
+            for (int j = 0; j < 4; j++) {
+                if (laps[j] < best[j]) best[j] = laps[j];
+            }
+            // Kernels add in a different order, so allow for rounding
+            double drift = sum > expectedSum ? sum - expectedSum : expectedSum - sum;
+            if (drift > expectedSum * 1e-9 + 1e-6 ||
+                memcmp(counts, expectedCounts, sizeof(counts)) != 0 ||
+                timeMatched != expectedTime || customerMatched != expectedCustomer ||
+                memcmp(rows, expectedRows, customerMatched * sizeof(int)) != 0) {
+                agree = false;
+            }
         }
+        printf("%-14s %12.2f %12.2f %12.2f %12.2f %12.2f\n", kernels->name, best[0] * 1e3, best[1] * 1e3,
+               best[2] * 1e3, best[3] * 1e3, (best[0] + best[1] + best[2] + best[3]) * 1e3);
+    }
+    printf("Selected at startup: %s\n", columnKernels->name);
+    free(expectedRows);
+    free(rows);
+    if (!agree) {
+        printColored(COLOR_RED "Kernels disagree with the row loops!\n" COLOR_RESET);
+        return 1;
     }
-    printf("--------------------------------------------------------------------\n");
+    return 0;
 }
 
-void updateOrderStatus() {
-    viewOrders("Chef", "Chef");
-    if (orderCount == 0) return;
-    
-    int orderNum = getNumericInput(1, orderCount, "Enter order number to update status: ");
-    
-    printf("Current status: %s\n", orders[orderNum-1].status);
-    printf("Enter new status (Processing/Ready/Delivered): ");
-    char status[20];
-    scanf("%19s", status);
-    clearInputBuffer();
-    
-    if (strcmp(status, "Processing") != 0 && strcmp(status, "Ready") != 0 && strcmp(status, "Delivered") != 0) {
-        printf(COLOR_RED "Invalid status! Status remains unchanged.\n" COLOR_RESET);
-        return;
+bool recordLatency(LatencySamples *latency, double seconds) {
+    if (latency->count == latency->capacity) {
+        int newCapacity = latency->capacity ? latency->capacity * 2 : 1024;
+        double *samples = realloc(latency->samples, newCapacity * sizeof(double));
+        if (samples == NULL) return false;
+        latency->samples = samples;
+        latency->capacity = newCapacity;
     }
-    
-    strcpy(orders[orderNum-1].status, status);
-    saveAllOrdersToFile();
-    printf(COLOR_GREEN "Order status updated!\n" COLOR_RESET);
+    latency->samples[latency->count++] = seconds;
+    return true;
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+double percentile(const double *sorted, int count, double fraction) {
+    if (count == 0) return 0;
+    int rank = (int)(fraction * count + 0.999999);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+const char *registerCommand(int argc, char *argv[]) {
+    User user;
+    UserRole role;
+    const char *error = NULL;
+    if (argc != 6) return "usage: register <role> <username> <email> <phone> <password>";
+    if (!parseRole(argv[1], &role)) return "unknown role";
+    if (strlen(argv[5]) >= PASSWORD_INPUT_LENGTH || !isPasswordValid(argv[5])) return "password too weak or too long";
+
+    // Hash before taking userLock; the key derivation is the slow part
+    memset(&user, 0, sizeof(user));
+    if (!hashPassword(argv[5], user.password)) return "could not generate a salt";
+
+    WRITE_LOCK(userLock);
+    if (strlen(argv[2]) >= sizeof(user.username) || isUsernameTaken(argv[2])) {
+        error = "username taken or too long";
+    } else if (strlen(argv[3]) >= sizeof(user.email) || !isEmailValid(argv[3]) || isEmailTaken(argv[3])) {
+        error = "email invalid or taken";
+    } else if (!isPhoneValid(argv[4]) || isPhoneTaken(argv[4])) {
+        error = "phone invalid or taken";
+    } else {
+        user.role = role;
+        strcpy(user.username, argv[2]);
+        strcpy(user.email, argv[3]);
+        strcpy(user.phone, argv[4]);
+        if (!addUser(&user)) error = "out of memory";
+    }
+    RW_UNLOCK(userLock);
+    return error;
 }
 
-void processPayment(float total) {
-    printf(COLOR_CORAL "\nPayment Options:\n" COLOR_RESET);
-    printf("1. Cash\n2. BKash\n3. Rocket\n4. NAGAD\n5. VISA\n6. MASTERCARD\n");
-    int choice = getNumericInput(1, 6, "Select payment method: ");
+const char *orderCommand(int argc, char *argv[], char *detail) {
+    CartLine cart[MAX_CART_LINES];
+    float total;
+    if (argc < 4 || argc % 2 != 0) return "usage: order <username> <item#> <qty> [<item#> <qty> ...]";
+    if (!isUsernameTaken(argv[1])) return "unknown customer";
 
-    switch (choice) {
-        case 1:
-            printf(COLOR_GREEN "Paid %.2f in Cash. Thank you!\n" COLOR_RESET, total);
+    const MenuSnapshot *menu = acquireMenu();
+    int lineCount = (argc - 2) / 2;
+    for (int i = 0; i < lineCount; i++) {
+        cart[i].item = menuIdAt(menu, atoi(argv[2 + 2 * i]) - 1);
+        cart[i].quantity = atoi(argv[3 + 2 * i]);
+        if (cart[i].item == MENU_NO_ITEM) return "no such menu item";
+        if (cart[i].quantity < 1 || cart[i].quantity > 100) return "quantity must be 1-100";
+    }
+    int firstIndex = createOrders(argv[1], menu, cart, lineCount, &total);
+    if (firstIndex < 0) return "out of memory";
+    snprintf(detail, COMMAND_DETAIL_LENGTH, "%d", firstIndex + 1);
+    return NULL;
+}
+
+// Lists the numbers of the matching items, as many as fit in detail.
+const char *searchCommand(const char *prefix, char *detail) {
+    MenuItemId found[MENU_SEARCH_LIMIT];
+    const MenuSnapshot *menu = acquireMenu();
+    int count = searchMenu(menu, prefix, found, MENU_SEARCH_LIMIT);
+    int length = 0;
+    for (int i = 0; i < count; i++) {
+        int written = snprintf(detail + length, COMMAND_DETAIL_LENGTH - length, i ? ",%u" : "%u", (found[i] & MENU_SLOT_MASK) + 1);
+        if (written >= COMMAND_DETAIL_LENGTH - length) {
+            detail[length] = '\0';
             break;
-            
-        case 2: case 3: case 4: {
-            const char *service = (choice == 2) ? "BKash" : (choice == 3) ? "Rocket" : "NAGAD";
-            printf("\nProcessing payment via %s (%.2f)\n", service, total);
-            
-            char input[20];
-            while(1) {
-                printf("Enter mobile number (11 digits): ");
-                scanf("%11s", input);
-                clearInputBuffer();
-                if(strlen(input) == 11 && isdigit(input[0])) break;
-                printf(COLOR_RED "Invalid mobile number! Must be 11 digits.\n" COLOR_RESET);
-            }
-            
-            while(1) {
-                printf("Enter security code (3 digits): ");
-                hidePassword(input);
-                if(strlen(input) == 3 && isdigit(input[0])) break;
-                printf(COLOR_RED "Invalid security code! Must be 3 digits.\n" COLOR_RESET);
-            }
-            
-            while(1) {
-                printf("Enter %s PIN (4-6 digits): ", service);
-                hidePassword(input);
-                if(strlen(input) >= 4 && strlen(input) <= 6 && isdigit(input[0])) break;
-                printf(COLOR_RED "Invalid PIN! Must be 4-6 digits.\n" COLOR_RESET);
+        }
+        length += written;
+    }
+    return count > 0 ? NULL : "no matching items";
+}
+
+// Splits a command line into whitespace-separated tokens in place.
+int splitCommand(char *line, char *argv[]) {
+    char *state;
+    int argc = 0;
+    for (char *token = strtok_r(line, " \t\r\n", &state); token != NULL && argc < REPLAY_MAX_TOKENS;
+         token = strtok_r(NULL, " \t\r\n", &state)) {
+        argv[argc++] = token;
+    }
+    return argc;
+}
+
+// Executes one command of the replay/server protocol and takes the table locks
+// it needs; returns NULL on success or an error message. Commands that produce
+// an order number leave it in detail.
+const char *executeCommand(int argc, char *argv[], ReplayOp *op, char *detail) {
+    const char *error;
+    detail[0] = '\0';
+
+    if (strcmp(argv[0], "register") == 0) {
+        *op = OP_REGISTER;
+        return registerCommand(argc, argv);
+    }
+
+    if (strcmp(argv[0], "login") == 0) {
+        *op = OP_LOGIN;
+        UserRole role;
+        if (argc != 3) return "usage: login <username> <password>";
+        return userExists(argv[1], argv[2], &role) ? NULL : "invalid username or password";
+    }
+
+    if (strcmp(argv[0], "order") == 0) {
+        *op = OP_ORDER;
+        READ_LOCK(userLock);
+        error = orderCommand(argc, argv, detail);
+        RW_UNLOCK(userLock);
+        return error;
+    }
+
+    if (strcmp(argv[0], "status") == 0) {
+        *op = OP_STATUS;
+        OrderStatus status;
+        if (argc != 3) return "usage: status <order#> <Processing|Ready|Delivered>";
+        if (!parseOrderStatus(argv[2], &status)) return "invalid status";
+        return setOrderStatus(atoi(argv[1]) - 1, status) ? NULL : "no such order";
+    }
+
+    if (strcmp(argv[0], "next") == 0 || strcmp(argv[0], "deliver") == 0) {
+        *op = argv[0][0] == 'n' ? OP_NEXT : OP_DELIVER;
+        int orderIndex = *op == OP_NEXT ? completeNextTicket() : deliverNextOrder();
+        if (orderIndex < 0) return *op == OP_NEXT ? "no tickets waiting" : "no orders ready";
+        snprintf(detail, COMMAND_DETAIL_LENGTH, "%d", orderIndex + 1);
+        return NULL;
+    }
+
+    if (strcmp(argv[0], "pay") == 0) {
+        *op = OP_PAY;
+        if (argc != 3 && argc != 4) return "usage: pay <order#> <method> [lines]";
+        for (int method = CASH; method < PAYMENT_METHOD_COUNT; method++) {
+            if (strcasecmp(argv[2], paymentMethodNames[method]) == 0) {
+                int lines = argc == 4 ? atoi(argv[3]) : 1;
+                return submitPayment(atoi(argv[1]) - 1, lines, method, &error) ? NULL : error;
             }
-            
-            printf(COLOR_GREEN "Payment of %.2f via %s successful!\n" COLOR_RESET, total, service);
-            printf(COLOR_GREEN "------------ Order has been placed ----------\n" COLOR_RESET);
-            break;
         }
-            
-        case 5: case 6: {
-            const char *cardType = (choice == 5) ? "VISA" : "Mastercard";
-            printf("\nProcessing payment via %s (%.2f)\n", cardType, total);
-            
-            char input[20];
-            while(1) {
-                printf("Enter %s card number (16 digits): ", cardType);
-                scanf("%16s", input);
-                clearInputBuffer();
-                if(strlen(input) == 16 && isdigit(input[0])) break;
-                printf(COLOR_RED "Invalid card number! Must be 16 digits.\n" COLOR_RESET);
+        return "unknown payment method";
+    }
+
+    if (strcmp(argv[0], "search") == 0) {
+        *op = OP_SEARCH;
+        if (argc != 2) return "usage: search <prefix>";
+        return searchCommand(argv[1], detail);
+    }
+
+    if (strcmp(argv[0], "metrics") == 0) {
+        *op = OP_METRICS;
+        if (!metricsEnabled) return "metrics are off; set METRICS_FILE";
+        return dumpMetrics() ? NULL : "cannot write metrics";
+    }
+
+    *op = OP_COUNT;
+    return "unknown command";
+}
+
+void loadTables() {
+    initializeMenu();
+    uint64_t start = metricStart();
+    loadUsersFromFile();
+    metricStop(METRIC_LOAD_USERS, start);
+    start = metricStart();
+    loadOrdersFromFile();
+    metricStop(METRIC_LOAD_ORDERS, start);
+    start = metricStart();
+    openOrderLog();
+    metricStop(METRIC_REPLAY_LOG, start);
+    startPersistence();
+    startPayments();
+    rebuildKitchenQueues();
+    rebuildSalesAnalytics();
+    rebuildTimeIndex();
+}
+
+// Runs a command stream from a file (or stdin for "-") against the same tables
+// and files as the interactive UI, without prompts, then reports throughput and
+// latency percentiles per operation.
+int runReplay(const char *path) {
+    static const char *opNames[OP_COUNT] = {"register", "login", "order", "status", "pay", "next", "deliver", "search", "metrics"};
+    FILE *input = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (input == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 1;
+    }
+
+    loadTables();
+
+    LatencySamples latency[OP_COUNT];
+    memset(latency, 0, sizeof(latency));
+    char line[REPLAY_LINE_LENGTH];
+    char *argv[REPLAY_MAX_TOKENS];
+    char detail[COMMAND_DETAIL_LENGTH];
+    int lineNumber = 0, failures = 0;
+    double started = monotonicSeconds();
+
+    while (fgets(line, sizeof(line), input) != NULL) {
+        lineNumber++;
+        int argc = splitCommand(line, argv);
+        if (argc == 0 || argv[0][0] == '#') continue;
+
+        ReplayOp op;
+        double start = monotonicSeconds();
+        const char *error = executeCommand(argc, argv, &op, detail);
+        double elapsed = monotonicSeconds() - start;
+
+        if (op == OP_COUNT) {
+            fprintf(stderr, "line %d: %s '%s'\n", lineNumber, error, argv[0]);
+            failures++;
+            continue;
+        }
+        recordLatency(&latency[op], elapsed);
+        if (error != NULL) {
+            fprintf(stderr, "line %d: %s: %s\n", lineNumber, opNames[op], error);
+            latency[op].errors++;
+            failures++;
+        }
+    }
+    double wallSeconds = monotonicSeconds() - started;
+    if (input != stdin) fclose(input);
+    stopPayments();
+    stopPersistence();
+
+    printf("%-10s %10s %8s %12s %10s %10s %10s %10s\n",
+           "operation", "count", "errors", "ops/sec", "p50 us", "p90 us", "p99 us", "max us");
+    for (int op = 0; op < OP_COUNT; op++) {
+        LatencySamples *l = &latency[op];
+        if (l->count == 0) continue;
+
+        double busy = 0;
+        for (int i = 0; i < l->count; i++) busy += l->samples[i];
+        qsort(l->samples, l->count, sizeof(double), compareDoubles);
+        printf("%-10s %10d %8d %12.0f %10.1f %10.1f %10.1f %10.1f\n",
+               opNames[op], l->count, l->errors, busy > 0 ? l->count / busy : 0,
+               percentile(l->samples, l->count, 0.50) * 1e6,
+               percentile(l->samples, l->count, 0.90) * 1e6,
+               percentile(l->samples, l->count, 0.99) * 1e6,
+               l->samples[l->count - 1] * 1e6);
+        free(l->samples);
+    }
+    printf("%d lines in %.3f s, %d failed\n", lineNumber, wallSeconds, failures);
+
+    // Gateway payments settle after their command returns, so they get their
+    // own line: throughput from first submit to last result, latency including
+    // time spent queued behind other payments.
+    LatencySamples *settled = &paymentQueue.latency;
+    if (settled->count > 0) {
+        double span = paymentQueue.lastSettled - paymentQueue.firstSubmitted;
+        qsort(settled->samples, settled->count, sizeof(double), compareDoubles);
+        printf("payments via %s: %d paid, %d declined, %.1f/s; settle p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+               paymentProvider->name, paymentQueue.paid, paymentQueue.declined,
+               span > 0 ? settled->count / span : 0,
+               percentile(settled->samples, settled->count, 0.50) * 1e3,
+               percentile(settled->samples, settled->count, 0.99) * 1e3,
+               settled->samples[settled->count - 1] * 1e3);
+        free(settled->samples);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+#ifndef _WIN32
+volatile sig_atomic_t serverStopping = 0;
+volatile sig_atomic_t metricsDumpRequested = 0;
+
+void stopServer(int signum) {
+    (void)signum;
+    serverStopping = 1;
+}
+
+void requestMetricsDump(int signum) {
+    (void)signum;
+    metricsDumpRequested = 1;
+}
+
+Session *nextPendingSession(WorkQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->stopping) {
+        pthread_cond_wait(&queue->ready, &queue->lock);
+    }
+    Session *session = NULL;
+    if (queue->count > 0) {
+        session = queue->pending[queue->head];
+        queue->head = (queue->head + 1) % SERVER_MAX_SESSIONS;
+        queue->count--;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return session;
+}
+
+void *serverWorker(void *arg) {
+    WorkQueue *queue = arg;
+    Session *session;
+    char *argv[REPLAY_MAX_TOKENS];
+    char reply[REPLAY_LINE_LENGTH];
+    char detail[COMMAND_DETAIL_LENGTH];
+
+    while ((session = nextPendingSession(queue)) != NULL) {
+        ReplayOp op;
+        int argc = splitCommand(session->command, argv);
+        const char *error = executeCommand(argc, argv, &op, detail);
+        int length = error != NULL ? snprintf(reply, sizeof(reply), "ERR %s\n", error)
+                   : detail[0] ? snprintf(reply, sizeof(reply), "OK %s\n", detail)
+                               : snprintf(reply, sizeof(reply), "OK\n");
+
+        for (int offset = 0; offset < length; ) {
+            ssize_t written = write(session->fd, reply + offset, length - offset);
+            if (written <= 0) break;
+            offset += written;
+        }
+        atomic_store(&session->busy, false);
+        if (write(queue->wakeup[1], "", 1) < 0) {
+            // The poll loop also wakes on its own traffic; a full pipe is harmless
+        }
+    }
+    return NULL;
+}
+
+// Hands the next complete line of an idle session to the pool.
+void dispatchSession(WorkQueue *queue, Session *session) {
+    while (1) {
+        if (session->length == 0) return;
+        char *newline = memchr(session->input, '\n', session->length);
+        if (newline == NULL && session->length < sizeof(session->input) - 1 && !session->hungUp) return;
+
+        size_t lineLength = newline ? (size_t)(newline - session->input) + 1 : session->length;
+        memcpy(session->command, session->input, lineLength);
+        session->command[lineLength] = '\0';
+        memmove(session->input, session->input + lineLength, session->length - lineLength);
+        session->length -= lineLength;
+
+        // Blank lines and comments are answered by silence, as in a replay file
+        char *start = session->command + strspn(session->command, " \t\r\n");
+        if (*start != '\0' && *start != '#') break;
+    }
+
+    atomic_store(&session->busy, true);
+    pthread_mutex_lock(&queue->lock);
+    queue->pending[(queue->head + queue->count) % SERVER_MAX_SESSIONS] = session;
+    queue->count++;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Serves the replay command protocol on a Unix-domain socket. One thread polls
+// every connection and dispatches complete lines to a fixed worker pool; each
+// command is answered with "OK" or "ERR <reason>".
+int runServer(const char *socketPath, int threadCount) {
+    static WorkQueue queue;
+    static Session *sessions[SERVER_MAX_SESSIONS];
+    static struct pollfd fds[SERVER_MAX_SESSIONS + 2];
+    static Session *polled[SERVER_MAX_SESSIONS + 2];
+    int sessionCount = 0;
+
+    if (threadCount < 1) threadCount = 1;
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, 64) != 0 || pipe(queue.wakeup) != 0) {
+        perror("Cannot start server");
+        return 1;
+    }
+    fcntl(queue.wakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl(queue.wakeup[1], F_SETFL, O_NONBLOCK);
+
+    // Threads inherit the signal mask, so the stop and dump signals stay blocked
+    // until the writer, payment and server threads exist. Only this thread then
+    // takes them, and they interrupt its poll.
+    sigset_t handled, previous;
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGINT);
+    sigaddset(&handled, SIGTERM);
+    sigaddset(&handled, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &handled, &previous);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGUSR1, requestMetricsDump);
+
+    loadTables();
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+    pthread_t *workers = malloc(threadCount * sizeof(pthread_t));
+    int started = 0;
+    while (workers != NULL && started < threadCount &&
+           pthread_create(&workers[started], NULL, serverWorker, &queue) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Cannot start server: no worker threads\n");
+        free(workers);
+        close(listener);
+        unlink(socketPath);
+        stopPayments();
+        stopPersistence();
+        return 1;
+    }
+    if (started < threadCount) {
+        printColored(COLOR_YELLOW "Started only %d of %d worker threads.\n" COLOR_RESET, started, threadCount);
+        threadCount = started;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    printf("Serving on %s with %d worker threads\n", socketPath, threadCount);
+    fflush(stdout);
+
+    while (!serverStopping) {
+        int fdCount = 0;
+        fds[fdCount].fd = listener;
+        fds[fdCount++].events = sessionCount < SERVER_MAX_SESSIONS ? POLLIN : 0;
+        fds[fdCount].fd = queue.wakeup[0];
+        fds[fdCount++].events = POLLIN;
+        for (int i = 0; i < sessionCount; i++) {
+            if (atomic_load(&sessions[i]->busy) || sessions[i]->hungUp) continue;
+            polled[fdCount] = sessions[i];
+            fds[fdCount].fd = sessions[i]->fd;
+            fds[fdCount++].events = POLLIN;
+        }
+
+        if (metricsDumpRequested) {
+            metricsDumpRequested = 0;
+            dumpMetrics();
+        }
+        if (poll(fds, fdCount, -1) < 0) continue; // EINTR from a stop or dump signal
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(queue.wakeup[0], drain, sizeof(drain)) > 0);
+        }
+        if ((fds[0].revents & POLLIN) && sessionCount < SERVER_MAX_SESSIONS) {
+            int fd = accept(listener, NULL, NULL);
+            Session *session = fd >= 0 ? calloc(1, sizeof(Session)) : NULL;
+            if (session != NULL) {
+                session->fd = fd;
+                atomic_init(&session->busy, false);
+                sessions[sessionCount++] = session;
+            } else if (fd >= 0) {
+                close(fd);
             }
-            
-            while(1) {
-                printf("Enter verification code (3-4 digits): ");
-                hidePassword(input);
-                if((strlen(input) == 3 || strlen(input) == 4) && isdigit(input[0])) break;
-                printf(COLOR_RED "Invalid verification code! Must be 3-4 digits.\n" COLOR_RESET);
+        }
+        for (int i = 2; i < fdCount; i++) {
+            if (fds[i].revents == 0) continue;
+            Session *session = polled[i];
+            ssize_t got = read(session->fd, session->input + session->length,
+                               sizeof(session->input) - 1 - session->length);
+            if (got <= 0) {
+                session->hungUp = true;
+            } else {
+                session->length += got;
             }
-            
-            while(1) {
-                printf("Enter card PIN (4 digits): ");
-                hidePassword(input);
-                if(strlen(input) == 4 && isdigit(input[0])) break;
-                printf(COLOR_RED "Invalid PIN! Must be 4 digits.\n" COLOR_RESET);
+        }
+
+        // Dispatch pending lines of idle sessions and retire closed ones
+        for (int i = 0; i < sessionCount; ) {
+            Session *session = sessions[i];
+            if (!atomic_load(&session->busy)) {
+                dispatchSession(&queue, session);
+                if (!atomic_load(&session->busy) && session->hungUp) {
+                    close(session->fd);
+                    free(session);
+                    sessions[i] = sessions[--sessionCount];
+                    continue;
+                }
             }
-            
-            printf(COLOR_GREEN "Payment of %.2f via %s successful!\n" COLOR_RESET, total, cardType);
-            break;
+            i++;
         }
-            
-        default:
-            printf(COLOR_RED "Invalid payment method. Defaulting to Cash.\n" COLOR_RESET);
-            printf(COLOR_GREEN "Paid %.2f in Cash. Thank you!\n" COLOR_RESET, total);
     }
+
+    pthread_mutex_lock(&queue.lock);
+    queue.stopping = true;
+    pthread_cond_broadcast(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+    for (int i = 0; i < threadCount; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    for (int i = 0; i < sessionCount; i++) {
+        close(sessions[i]->fd);
+        free(sessions[i]);
+    }
+    close(listener);
+    unlink(socketPath);
+    stopPayments();
+    stopPersistence();
+    printf("Server stopped.\n");
+    return 0;
+}
+#else
+int runServer(const char *socketPath, int threadCount) {
+    (void)socketPath;
+    (void)threadCount;
+    fprintf(stderr, "Server mode needs Unix-domain sockets and is not available on Windows.\n");
+    return 1;
+}
+#endif
+
+// Times the key derivation and suggests the iteration count that keeps one
+// login hash near targetMs on this machine.
+int benchmarkKdf(int targetMs) {
+    const uint8_t salt[PASSWORD_SALT_BYTES] = {0};
+    uint8_t hash[32];
+    if (targetMs <= 0) targetMs = KDF_DEFAULT_TARGET_MS;
+
+    printf("%-14s %12s\n", "Iterations", "ms per hash");
+    double msPerIteration = 0;
+    for (int iterations = KDF_MIN_ITERATIONS; iterations <= KDF_MAX_ITERATIONS; iterations *= 4) {
+        double start = monotonicSeconds();
+        pbkdf2Sha256("benchmark#1", salt, sizeof(salt), iterations, hash);
+        double ms = (monotonicSeconds() - start) * 1000;
+        printf("%-14d %12.2f\n", iterations, ms);
+        msPerIteration = ms / iterations;
+        // Stop once a run is long enough to time reliably
+        if (ms >= targetMs / 4.0) break;
+    }
+
+    // Scale to the target, then correct once against a run at that size
+    long tuned = 0;
+    double ms = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        tuned = (long)(targetMs / msPerIteration) / 1000 * 1000;
+        if (tuned < KDF_MIN_ITERATIONS) tuned = KDF_MIN_ITERATIONS;
+        if (tuned > KDF_MAX_ITERATIONS) tuned = KDF_MAX_ITERATIONS;
+        double start = monotonicSeconds();
+        pbkdf2Sha256("benchmark#1", salt, sizeof(salt), (int)tuned, hash);
+        ms = (monotonicSeconds() - start) * 1000;
+        msPerIteration = ms / tuned;
+    }
+    printf("\nTarget %d ms: %ld iterations (measured %.2f ms)\n", targetMs, tuned, ms);
+    printf("Current setting: %d iterations (~%.2f ms)\n", kdfIterations, kdfIterations * msPerIteration);
+    printf("Set KDF_ITERATIONS=%ld to use it; existing hashes are upgraded at their next login.\n", tuned);
+    return 0;
+}
+
+uint64_t nextRandom(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+double nextUnit(uint64_t *state) {
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+bool zipfInit(ZipfTable *table, int count) {
+    table->cdf = malloc(count * sizeof(double));
+    table->count = count;
+    if (table->cdf == NULL) return false;
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += 1.0 / (i + 1);
+        table->cdf[i] = sum;
+    }
+    for (int i = 0; i < count; i++) table->cdf[i] /= sum;
+    return true;
+}
+
+int zipfDraw(const ZipfTable *table, uint64_t *state) {
+    double u = nextUnit(state);
+    int low = 0, high = table->count - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (table->cdf[mid] < u) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+int compareInt64(const void *a, const void *b) {
+    int64_t left = *(const int64_t *)a, right = *(const int64_t *)b;
+    return (left > right) - (left < right);
+}
+
+// Builds a menu of itemTotal dishes named from word lists across a dozen
+// categories, with prices from 40tk to 800tk, most of them cheap.
+MenuSnapshot *benchMenu(int itemTotal, uint64_t *seed) {
+    static const char *styles[] = {"Spicy", "Grilled", "Butter", "Garlic", "Smoked", "Crispy", "Masala", "Tandoori"};
+    static const char *mains[] = {"Chicken", "Beef", "Prawn", "Paneer", "Mutton", "Veg", "Fish", "Egg"};
+    static const char *dishes[] = {"Biryani", "Curry", "Kebab", "Wrap", "Soup", "Rice", "Noodles", "Salad"};
+    static const char *categories[] = {"Bengali", "Pakistani", "Turkish", "Indian", "Chinese", "Thai",
+                                       "Grill", "Breads", "Desserts", "Drinks", "Seafood", "Specials"};
+    MenuSnapshot *menu = buildMenu(itemTotal);
+    if (menu == NULL) return NULL;
+    menu->version = 1;
+    char name[50];
+    for (int i = 0; i < itemTotal; i++) {
+        int combo = i % 512;
+        if (i < 512) {
+            snprintf(name, sizeof(name), "%s %s %s", styles[combo / 64], mains[combo / 8 % 8], dishes[combo % 8]);
+        } else {
+            snprintf(name, sizeof(name), "%s %s %s %d", styles[combo / 64], mains[combo / 8 % 8], dishes[combo % 8], i / 512 + 1);
+        }
+        MenuSlot *slot = (MenuSlot *)menuSlotAt(menu, i);
+        slot->item.name = internName(name);
+        strcpy(slot->item.category, categories[nextRandom(seed) % 12]);
+        double u = nextUnit(seed);
+        slot->item.price = (float)((40 + (int)(760 * u * u * u)) / 5 * 5);
+        slot->live = slot->item.name != NULL;
+    }
+    if (finishMenu(menu)) return menu;
+    freeMenu(menu);
+    return NULL;
+}
+
+// Writes users.txt and orders.txt style tables for the suite. Customers and
+// dishes are Zipf-skewed; orders cover the last BENCH_HISTORY_DAYS days with
+// lunch and dinner peaks, and older orders are delivered and mostly paid.
+bool generateBenchTables(int userTotal, const MenuSnapshot *menu, int orderTotal, uint64_t *seed) {
+    static const int hourWeights[24] = {1, 1, 1, 1, 1, 1, 2, 3, 4, 4, 5, 8, 12, 14, 9, 6, 5, 7, 11, 14, 12, 8, 4, 2};
+    char password[PASSWORD_HASH_LENGTH];
+    // One hash shared by every user: hashing each would dominate generation
+    if (!hashPassword(BENCH_PASSWORD, password)) return false;
+
+    TextBuffer rows = {0};
+    bool ok = true;
+    for (int i = 0; ok && i < userTotal; i++) {
+        UserRole role = i % 500 == 499 ? ROLE_CHEF : i % 1000 == 999 ? ROLE_ADMIN : ROLE_CUSTOMER;
+        ok = textAppendf(&rows, "user%07d,user%07d@example.com,017%08d,%s,%s\n", i, i, i, password, roleName(role));
+    }
+    ok = ok && writeTextFile(USER_DB_FILE, &rows);
+    rows.length = 0;
+
+    ZipfTable customers, items;
+    int64_t *times = malloc(orderTotal * sizeof(int64_t));
+    int *itemOrder = malloc(menu->slotCount * sizeof(int));
+    ok = ok && zipfInit(&customers, userTotal) &&
+         zipfInit(&items, menu->slotCount) && times != NULL && itemOrder != NULL;
+    if (!ok) {
+        free(rows.data);
+        free(times);
+        free(itemOrder);
+        return false;
+    }
+
+    // Popularity ranks map to shuffled slots, so best sellers span categories
+    for (int i = 0; i < menu->slotCount; i++) itemOrder[i] = i;
+    for (int i = menu->slotCount - 1; i > 0; i--) {
+        int j = (int)(nextRandom(seed) % (i + 1)), swap = itemOrder[i];
+        itemOrder[i] = itemOrder[j];
+        itemOrder[j] = swap;
+    }
+
+    time_t now = time(NULL), dayStart, dayEnd;
+    localDay(now, &dayStart, &dayEnd);
+    int weightTotal = 0;
+    for (int h = 0; h < 24; h++) weightTotal += hourWeights[h];
+    for (int i = 0; i < orderTotal; i++) {
+        int pick = (int)(nextRandom(seed) % weightTotal), hour = 0;
+        while (pick >= hourWeights[hour]) pick -= hourWeights[hour++];
+        int day = (int)(nextRandom(seed) % BENCH_HISTORY_DAYS);
+        int64_t t = (int64_t)dayStart - (int64_t)day * 86400 + hour * 3600 + (int64_t)(nextRandom(seed) % 3600);
+        times[i] = t < now ? t : now - (int64_t)(nextRandom(seed) % 3600);
+    }
+    qsort(times, orderTotal, sizeof(int64_t), compareInt64);
+
+    for (int i = 0; ok && i < orderTotal; i++) {
+        int user = zipfDraw(&customers, seed);
+        if (user % 500 == 499) user--; // staff do not order
+        const MenuItem *item = &menuSlotAt(menu, itemOrder[zipfDraw(&items, seed)])->item;
+        int roll = (int)(nextRandom(seed) % 100);
+        int quantity = roll < 60 ? 1 : roll < 85 ? 2 : 3 + roll % 3;
+        int64_t age = (int64_t)now - times[i];
+        OrderStatus status = age > 7200 ? STATUS_DELIVERED : age > 1800 ? (roll < 70 ? STATUS_READY : STATUS_DELIVERED)
+                                                                        : STATUS_PROCESSING;
+        PaymentState payment = status == STATUS_DELIVERED ? (roll < 97 ? PAYMENT_PAID : PAYMENT_DECLINED)
+                                                          : (roll < 60 ? PAYMENT_PAID : PAYMENT_UNPAID);
+        ok = textAppendf(&rows, "user%07d,%s,%d,%s,%.2f,%lld,%s\n", user, item->name, quantity, statusNames[status],
+                         quantity * item->price, (long long)times[i], paymentStateNames[payment]);
+    }
+    ok = ok && writeTextFile(ORDER_DB_FILE, &rows);
+    free(rows.data);
+    free(times);
+    free(itemOrder);
+    free(customers.cdf);
+    free(items.cdf);
+    return ok;
+}
+
+void printBenchRow(const char *phase, LatencySamples *latency, double wallSeconds) {
+    if (latency->count == 0) return;
+    qsort(latency->samples, latency->count, sizeof(double), compareDoubles);
+    printf("%-22s %9d %11.1f %12.0f %10.1f %10.1f %10.1f\n", phase, latency->count, wallSeconds * 1e3,
+           wallSeconds > 0 ? latency->count / wallSeconds : 0,
+           percentile(latency->samples, latency->count, 0.50) * 1e6,
+           percentile(latency->samples, latency->count, 0.99) * 1e6,
+           latency->samples[latency->count - 1] * 1e6);
+    free(latency->samples);
+    memset(latency, 0, sizeof(*latency));
+}
+
+// Times one call of a whole-table step as a row of its own
+void benchOnce(const char *phase, void (*step)()) {
+    LatencySamples latency = {0};
+    double start = monotonicSeconds();
+    step();
+    double elapsed = monotonicSeconds() - start;
+    recordLatency(&latency, elapsed);
+    printBenchRow(phase, &latency, elapsed);
+}
+
+void rebuildDerivedIndexes() {
+    rebuildKitchenQueues();
+    rebuildSalesAnalytics();
+    rebuildTimeIndex();
+}
+
+void openBenchLog() {
+    openOrderLog();
+    startPersistence();
+}
+
+// Folds the log into a fresh snapshot under the same locks as compactIfDue
+void compactBenchLog() {
+    flushPersistence();
+    MUTEX_LOCK(orderLogFileLock);
+    READ_LOCK(orderLock);
+    MUTEX_LOCK(orderLogLock);
+    compactOrderLog();
+    MUTEX_UNLOCK(orderLogLock);
+    RW_UNLOCK(orderLock);
+    MUTEX_UNLOCK(orderLogFileLock);
+}
+
+// Generates userTotal users, itemTotal dishes and orderTotal orders into
+// bench_* files, loads them through the normal loaders and times the
+// operations the UI and server depend on. Output is one row per phase with a
+// fixed layout, so runs on two commits can be diffed. Per-operation latencies
+// include a clock read (tens of nanoseconds).
+int benchmarkSuite(int userTotal, int itemTotal, int orderTotal) {
+    if (userTotal < 10) userTotal = 10;
+    if (itemTotal < 1) itemTotal = 1;
+    if (itemTotal > 4096) itemTotal = 4096;
+    if (orderTotal < 1) orderTotal = 1;
+    USER_DB_FILE = "bench_users.txt";
+    ORDER_DB_FILE = "bench_orders.txt";
+    ORDER_LOG_FILE = "bench_orders.log";
+    MENU_DB_FILE = "bench_menu.dat";
+    remove(ORDER_LOG_FILE);
+    uint64_t seed = BENCH_SEED;
+
+    printf("users %d, items %d, orders %d, seed %08x, kernels %s, kdf %d iterations\n",
+           userTotal, itemTotal, orderTotal, BENCH_SEED, columnKernels->name, kdfIterations);
+    double start = monotonicSeconds();
+    // Only the files are needed; the suite loads the menu back like a normal start
+    MenuSnapshot *menu = benchMenu(itemTotal, &seed);
+    bool generated = menu != NULL && saveMenuToFile(menu) && generateBenchTables(userTotal, menu, orderTotal, &seed);
+    freeMenu(menu);
+    if (!generated) {
+        printColored(COLOR_RED "Could not generate the benchmark tables!\n" COLOR_RESET);
+        return 1;
+    }
+    printf("generated in %.1f ms\n\n", (monotonicSeconds() - start) * 1e3);
+    printf("%-22s %9s %11s %12s %10s %10s %10s\n", "phase", "ops", "total ms", "ops/sec", "p50 us", "p99 us", "max us");
+
+    benchOnce("load menu", initializeMenu);
+    benchOnce("load users", loadUsersFromFile);
+    benchOnce("load orders", loadOrdersFromFile);
+    benchOnce("open order log", openBenchLog);
+    benchOnce("rebuild indexes", rebuildDerivedIndexes);
+    if (userStore.count != userTotal || orderStore.count != orderTotal) {
+        printColored(COLOR_RED "Loaded %d users and %d orders, expected %d and %d!\n" COLOR_RESET,
+               userStore.count, orderStore.count, userTotal, orderTotal);
+        stopPersistence();
+        return 1;
+    }
+
+    ZipfTable customers;
+    if (!zipfInit(&customers, userTotal)) {
+        printColored(COLOR_RED "Out of memory!\n" COLOR_RESET);
+        stopPersistence();
+        return 1;
+    }
+    LatencySamples latency = {0};
+    char username[50], password[] = BENCH_PASSWORD;
+    UserRole role;
+    volatile int sink = 0;
+
+    seed = BENCH_SEED ^ 1;
+    start = monotonicSeconds();
+    for (int i = 0; i < 100000; i++) {
+        snprintf(username, sizeof(username), "user%07d", zipfDraw(&customers, &seed));
+        double t = monotonicSeconds();
+        sink += hashIndexFind(&usernameIndex, username);
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("user lookup", &latency, monotonicSeconds() - start);
+
+    // A first login pays for the key derivation; later ones hit the cache
+    start = monotonicSeconds();
+    for (int i = 0; i < 10; i++) {
+        snprintf(username, sizeof(username), "user%07d", i * 7);
+        double t = monotonicSeconds();
+        sink += userExists(username, password, &role);
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("login (first)", &latency, monotonicSeconds() - start);
+    start = monotonicSeconds();
+    for (int i = 0; i < 10000; i++) {
+        double t = monotonicSeconds();
+        sink += userExists(username, password, &role);
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("login (cached)", &latency, monotonicSeconds() - start);
+
+    const MenuSnapshot *live = acquireMenu();
+    ZipfTable items;
+    if (!zipfInit(&items, live->slotCount)) {
+        printColored(COLOR_RED "Out of memory!\n" COLOR_RESET);
+        stopPersistence();
+        return 1;
+    }
+    start = monotonicSeconds();
+    for (int i = 0; i < 20000; i++) {
+        CartLine cart[3];
+        int lineCount = 1 + (int)(nextRandom(&seed) % 3);
+        for (int line = 0; line < lineCount; line++) {
+            cart[line].item = menuIdAt(live, zipfDraw(&items, &seed));
+            cart[line].quantity = 1 + (int)(nextRandom(&seed) % 3);
+        }
+        int user = zipfDraw(&customers, &seed);
+        snprintf(username, sizeof(username), "user%07d", user % 500 == 499 ? user - 1 : user);
+        float total;
+        double t = monotonicSeconds();
+        sink += createOrders(username, live, cart, lineCount, &total);
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("order insert", &latency, monotonicSeconds() - start);
+    benchOnce("log flush", flushPersistence);
+
+    start = monotonicSeconds();
+    for (int i = 0; i < 20000; i++) {
+        int orderIndex = orderStore.count - 1 - (int)(nextRandom(&seed) % 5000);
+        double t = monotonicSeconds();
+        sink += setOrderStatus(orderIndex, STATUS_READY);
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("status update", &latency, monotonicSeconds() - start);
+    start = monotonicSeconds();
+    for (int i = 0; i < 5000; i++) {
+        double t = monotonicSeconds();
+        sink += completeNextTicket();
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("next ticket", &latency, monotonicSeconds() - start);
+
+    // Listings build their screens as usual; only the final write is skipped
+    discardScreens = true;
+    start = monotonicSeconds();
+    for (int i = 0; i < 500; i++) {
+        double t = monotonicSeconds();
+        showMenu(acquireMenu());
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("menu listing", &latency, monotonicSeconds() - start);
+    start = monotonicSeconds();
+    MenuItemId found[MENU_SEARCH_LIMIT];
+    for (int i = 0; i < 10000; i++) {
+        // Two or three letters of a popular dish, as a customer would type
+        const char *name = menuSlotAt(live, zipfDraw(&items, &seed))->item.name;
+        char word[4] = {name[0], name[1], (char)(i % 3 ? name[2] : '\0'), '\0'};
+        double t = monotonicSeconds();
+        sink += searchMenu(live, word, found, MENU_SEARCH_LIMIT);
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("menu search", &latency, monotonicSeconds() - start);
+    start = monotonicSeconds();
+    for (int i = 0; i < 500; i++) {
+        int user = zipfDraw(&customers, &seed);
+        snprintf(username, sizeof(username), "user%07d", user);
+        double t = monotonicSeconds();
+        viewOrders(ROLE_CUSTOMER, username);
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("customer orders", &latency, monotonicSeconds() - start);
+
+    time_t now = time(NULL), dayStart, dayEnd;
+    localDay(now, &dayStart, &dayEnd);
+    const char *ranges[] = {"orders page (30 min)", "orders page (today)", "orders page (all)"};
+    time_t from[] = {now - RECENT_ORDER_MINUTES * 60, dayStart, 0};
+    for (int r = 0; r < 3; r++) {
+        start = monotonicSeconds();
+        for (int i = 0; i < 1000; i++) {
+            double t = monotonicSeconds();
+            int begin = findOrdersFrom(from[r]);
+            int total = orderTimeIndex.count - begin;
+            int pages = total > 0 ? (total + ORDER_PAGE_SIZE - 1) / ORDER_PAGE_SIZE : 1;
+            int page = (int)(nextRandom(&seed) % pages);
+            int first = begin + page * ORDER_PAGE_SIZE;
+            int last = first + ORDER_PAGE_SIZE < orderTimeIndex.count ? first + ORDER_PAGE_SIZE : orderTimeIndex.count;
+            viewOrderRange(first, last, page + 1, pages);
+            recordLatency(&latency, monotonicSeconds() - t);
+        }
+        printBenchRow(ranges[r], &latency, monotonicSeconds() - start);
+    }
+    start = monotonicSeconds();
+    for (int i = 0; i < 100; i++) {
+        double t = monotonicSeconds();
+        viewSalesReports();
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("sales report", &latency, monotonicSeconds() - start);
+    start = monotonicSeconds();
+    for (int i = 0; i < 5; i++) {
+        double t = monotonicSeconds();
+        viewCustomerOrderHistory();
+        recordLatency(&latency, monotonicSeconds() - t);
+    }
+    printBenchRow("history report", &latency, monotonicSeconds() - start);
+    discardScreens = false;
+
+    benchOnce("log compaction", compactBenchLog);
+    stopPersistence();
+    free(customers.cdf);
+    free(items.cdf);
+    printf("\nTables left in %s, %s and %s.\n", USER_DB_FILE, ORDER_DB_FILE, MENU_DB_FILE);
+    return 0;
+}
+
+// Non-interactive entry points; returns -1 when the interactive UI should run.
+int runCommandLine(int argc, char *argv[]) {
+    if (argc < 2) return -1;
+
+    if (strcmp(argv[1], "--bench-user-index") == 0) {
+        return benchmarkUserIndex(argc >= 3 ? atoi(argv[2]) : 1000000);
+    }
+    if (strcmp(argv[1], "--bench-load") == 0) {
+        return benchmarkLoad(argc >= 3 ? atoi(argv[2]) : 2000000);
+    }
+    if (strcmp(argv[1], "--bench-columns") == 0) {
+        return benchmarkColumns(argc >= 3 ? atoi(argv[2]) : 4000000);
+    }
+    if (strcmp(argv[1], "--bench-kdf") == 0) {
+        return benchmarkKdf(argc >= 3 ? atoi(argv[2]) : KDF_DEFAULT_TARGET_MS);
+    }
+    if (strcmp(argv[1], "--bench") == 0) {
+        return benchmarkSuite(argc >= 3 ? atoi(argv[2]) : BENCH_DEFAULT_USERS,
+                              argc >= 4 ? atoi(argv[3]) : BENCH_DEFAULT_ITEMS,
+                              argc >= 5 ? atoi(argv[4]) : BENCH_DEFAULT_ORDERS);
+    }
+    if (strcmp(argv[1], "--replay") == 0) {
+        return runReplay(argc >= 3 ? argv[2] : "-");
+    }
+    if (strcmp(argv[1], "--serve") == 0) {
+        return runServer(argc >= 3 ? argv[2] : SERVER_DEFAULT_SOCKET,
+                         argc >= 4 ? atoi(argv[3]) : SERVER_DEFAULT_THREADS);
+    }
+
+    printf("Usage: %s [--replay [file|-] | --serve [socket] [threads] |\n"
+           "          --bench [users] [items] [orders] |\n"
+           "          --bench-user-index [users] | --bench-load [orders] | --bench-columns [orders] |\n"
+           "          --bench-kdf [target-ms]]\n", argv[0]);
+    return 2;
 }
 
+int main(int argc, char *argv[]) {
+    initOutput();
+    initCrc32();
+    selectColumnKernels();
+    initPasswordHashing();
+    initPayments();
+    initMetrics();
+    int status = runCommandLine(argc, argv);
+    if (status >= 0) return status;
+
 
-int main() {
     // Initialize Windows console for ANSI colors if on Windows
     
     #ifdef _WIN32
@@ -863,34 +6266,32 @@ int main() {
     SetConsoleMode(hConsole, mode);
     #endif
 
-    initializeMenu();
-    loadUsersFromFile();
-    loadOrdersFromFile();
+    loadTables();
     
     displayLogo();
     
     while (1) {
-        char selectedRole[20];
-        printf(COLOR_AQUA "\nSelect your role:\n");
-        printf("1. Admin\n2. Customer\n3. Chef/Kitchen Staff\n4. Exit\n" COLOR_RESET);
+        UserRole selectedRole;
+        renderText(COLOR_AQUA "\nSelect your role:\n"
+                   "1. Admin\n2. Customer\n3. Chef/Kitchen Staff\n4. Exit\n" COLOR_RESET);
         int roleChoice = getNumericInput(1, 4, "Enter your choice: ");
         
         if (roleChoice == 4) {
-            printf(COLOR_YELLOW "\nExiting the system. Goodbye!\n" COLOR_RESET);
+            printColored(COLOR_YELLOW "\nExiting the system. Goodbye!\n" COLOR_RESET);
             break;
         }
         
         switch (roleChoice) {
-            case 1: strcpy(selectedRole, "Admin"); break;
-            case 2: strcpy(selectedRole, "Customer"); break;
-            case 3: strcpy(selectedRole, "Chef"); break;
+            case 1: selectedRole = ROLE_ADMIN; break;
+            case 2: selectedRole = ROLE_CUSTOMER; break;
+            case 3: selectedRole = ROLE_CHEF; break;
             default:
-                printf(COLOR_RED "Invalid choice. Please try again.\n" COLOR_RESET);
+                printColored(COLOR_RED "Invalid choice. Please try again.\n" COLOR_RESET);
                 continue;
         }
         
         while (1) {
-            printf(COLOR_CORAL "\n1. Register\n2. Login\n3. Back to Role Selection\n" COLOR_RESET);
+            renderText(COLOR_CORAL "\n1. Register\n2. Login\n3. Back to Role Selection\n" COLOR_RESET);
             int authChoice = getNumericInput(1, 3, "Enter your choice: ");
             
             if (authChoice == 3) break;
@@ -898,16 +6299,16 @@ int main() {
             if (authChoice == 1) {
                 registerUser(selectedRole);
             } else if (authChoice == 2) {
-                char role[20];
+                UserRole role;
                 char username[50];
-                if (loginUser(role, username)) {
-                    printf(COLOR_GREEN "\nLogin successful as %s!\n" COLOR_RESET, role);
+                if (loginUser(&role, username)) {
+                    printColored(COLOR_GREEN "\nLogin successful as %s!\n" COLOR_RESET, roleName(role));
                     
-                    if (strcmp(role, "Admin") == 0) {
+                    if (role == ROLE_ADMIN) {
                         adminMenu(username);
-                    } else if (strcmp(role, "Customer") == 0) {
+                    } else if (role == ROLE_CUSTOMER) {
                         customerMenu(username);
-                    } else if (strcmp(role, "Chef") == 0) {
+                    } else if (role == ROLE_CHEF) {
                         chefMenu(username);
                     }
                 }
@@ -915,6 +6316,7 @@ int main() {
         }
     }
     
-    saveAllOrdersToFile();
+    stopPayments();
+    stopPersistence();
     return 0;
 }
\ No newline at end of file